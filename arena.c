@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+size_t arenaAlignUp(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+int arenaInit(struct Arena *arena, size_t size) {
+    arena->size = arenaAlignUp(size > 0 ? size : 1, ARENA_ALIGN);
+    arena->used = 0;
+    arena->base = aligned_alloc(ARENA_ALIGN, arena->size);
+    if (arena->base == NULL) return -1;
+
+    memset(arena->base, 0, arena->size);
+    return 0;
+}
+
+// memory comes back zeroed, NULL when the arena is exhausted
+void *arenaAlloc(struct Arena *arena, size_t size, size_t align) {
+    size_t start = arenaAlignUp(arena->used, align);
+    if (arena->base == NULL || start > arena->size || size > arena->size - start) return NULL;
+
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+void arenaRewind(struct Arena *arena, size_t mark) {
+    if (mark >= arena->used) return;
+    memset(arena->base + mark, 0, arena->used - mark);
+    arena->used = mark;
+}
+
+void arenaFree(struct Arena *arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
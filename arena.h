@@ -0,0 +1,22 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 64
+
+// bump allocator over one cache-line aligned block, freed all at once
+struct Arena {
+    char *base;
+    size_t size;
+    size_t used;
+};
+
+int arenaInit(struct Arena *arena, size_t size);
+void *arenaAlloc(struct Arena *arena, size_t size, size_t align);
+// drops everything allocated since used was mark, zeroing it again
+void arenaRewind(struct Arena *arena, size_t mark);
+void arenaFree(struct Arena *arena);
+size_t arenaAlignUp(size_t n, size_t align);
+
+#endif //ARENA_H
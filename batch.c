@@ -0,0 +1,346 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "engine.h"
+
+#define BATCH_BLOCK 256
+#define BATCH_MAX_SHARED 32
+// anything quieter than this, about -78 dBFS, counts as silence
+#define BATCH_SILENCE 4
+#define BATCH_DEFAULT_TAIL_MS 10000
+#define BATCH_DEFAULT_SILENCE_MS 50
+#define BATCH_DEFAULT_HOLD_MS 1000
+#define BATCH_DEFAULT_VELOCITY 127
+
+static int matrixError(const char *path, int line, const char *msg) {
+    fprintf(stderr, "%s:%d: %s\n", path, line, msg);
+    return -1;
+}
+
+// whitespace or comma separated ints, a-b adds every value in between
+static int parseInts(char *values, int *out, size_t *outLen, int min, int max) {
+    *outLen = 0;
+    for (char *token = strtok(values, " \t,"); token != NULL; token = strtok(NULL, " \t,")) {
+        char *end;
+        long first = strtol(token, &end, 10);
+        long last = first;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+        if (end == token || *end != '\0' || first < min || last > max || last < first) return -1;
+        for (long value = first; value <= last; value++) {
+            if (*outLen == BATCH_MAX_STEPS) return -1;
+            out[(*outLen)++] = value;
+        }
+    }
+    return *outLen > 0 ? 0 : -1;
+}
+
+static int parseFloats(char *values, float *out, size_t *outLen) {
+    *outLen = 0;
+    for (char *token = strtok(values, " \t,"); token != NULL; token = strtok(NULL, " \t,")) {
+        char *end;
+        double value = strtod(token, &end);
+        if (end == token || *end != '\0' || !(value >= 0) || *outLen == BATCH_MAX_STEPS) return -1;
+        out[(*outLen)++] = value;
+    }
+    return *outLen > 0 ? 0 : -1;
+}
+
+int batchLoadMatrix(struct BatchMatrix *matrix, const char *path) {
+    *matrix = (struct BatchMatrix){
+        .velocities = { BATCH_DEFAULT_VELOCITY },
+        .velocitiesLen = 1,
+        .holdsMs = { BATCH_DEFAULT_HOLD_MS },
+        .holdsLen = 1,
+        .tailMs = BATCH_DEFAULT_TAIL_MS,
+        .silenceMs = BATCH_DEFAULT_SILENCE_MS,
+        .sampleRate = DEFAULT_SAMPLE_RATE,
+    };
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char line[1024];
+    int lineNum = 0;
+    int err = 0;
+    while (err == 0 && fgets(line, sizeof(line), file) != NULL) {
+        lineNum++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+        char *key = strtok(line, " \t\r\n=");
+        if (key == NULL) continue;
+        char *values = strtok(NULL, "=\r\n");
+        if (values == NULL) {
+            err = matrixError(path, lineNum, "expected key = values");
+            break;
+        }
+
+        size_t len;
+        float single[BATCH_MAX_STEPS];
+        if (strcmp(key, "notes") == 0) {
+            if (parseInts(values, matrix->notes, &matrix->notesLen, 0, 127) != 0) err = matrixError(path, lineNum, "notes are 0-127");
+        } else if (strcmp(key, "velocities") == 0) {
+            if (parseInts(values, matrix->velocities, &matrix->velocitiesLen, 1, 127) != 0) err = matrixError(path, lineNum, "velocities are 1-127");
+        } else if (strcmp(key, "holdMs") == 0) {
+            if (parseFloats(values, matrix->holdsMs, &matrix->holdsLen) != 0) err = matrixError(path, lineNum, "bad hold time");
+        } else if (strcmp(key, "tailMs") == 0) {
+            if (parseFloats(values, single, &len) != 0 || len != 1) err = matrixError(path, lineNum, "bad tail time");
+            else matrix->tailMs = single[0];
+        } else if (strcmp(key, "silenceMs") == 0) {
+            if (parseFloats(values, single, &len) != 0 || len != 1) err = matrixError(path, lineNum, "bad silence time");
+            else matrix->silenceMs = single[0];
+        } else if (strcmp(key, "sampleRate") == 0) {
+            if (parseFloats(values, single, &len) != 0 || len != 1 || single[0] < 1) err = matrixError(path, lineNum, "bad sample rate");
+            else matrix->sampleRate = single[0];
+        } else {
+            err = matrixError(path, lineNum, "unknown key");
+        }
+    }
+    fclose(file);
+
+    if (err == 0 && matrix->notesLen == 0) err = matrixError(path, lineNum, "no notes");
+    return err;
+}
+
+static void putLe16(unsigned char *dst, uint16_t value) {
+    dst[0] = value & 0xff;
+    dst[1] = value >> 8;
+}
+
+static void putLe32(unsigned char *dst, uint32_t value) {
+    putLe16(dst, value & 0xffff);
+    putLe16(dst + 2, value >> 16);
+}
+
+// 16 bit PCM, samples interleaved and written little-endian whatever the host
+static int writeWav(const char *path, const int16_t *samples, size_t frames, int channels, int sampleRate) {
+    uint32_t dataLen = frames * channels * sizeof(int16_t);
+    unsigned char header[44];
+    memcpy(header, "RIFF", 4);
+    putLe32(header + 4, 36 + dataLen);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe32(header + 16, 16);
+    putLe16(header + 20, 1);
+    putLe16(header + 22, channels);
+    putLe32(header + 24, sampleRate);
+    putLe32(header + 28, sampleRate * channels * sizeof(int16_t));
+    putLe16(header + 32, channels * sizeof(int16_t));
+    putLe16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    putLe32(header + 40, dataLen);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    bool isOk = fwrite(header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; isOk && i < frames * channels; i++) {
+        unsigned char le[2];
+        putLe16(le, samples[i]);
+        isOk = fwrite(le, sizeof(le), 1, file) == 1;
+    }
+    if (fclose(file) != 0) isOk = false;
+    if (!isOk) fprintf(stderr, "%s: write failed\n", path);
+    return isOk ? 0 : -1;
+}
+
+struct BatchRun {
+    // compiled once, every render loads its own synth from it
+    const void *bin;
+    size_t binLen;
+    const struct BatchMatrix *matrix;
+    const struct PatchInput *shared;
+    size_t sharedLen;
+    const char *outDir;
+    size_t jobsLen;
+    // longest render, hold and tail, in frames
+    size_t maxFrames;
+    atomic_size_t next;
+    atomic_int failed;
+    atomic_size_t framesRendered;
+};
+
+// what the patch sees through @freq, @gate and @velocity
+struct BatchHost {
+    int16_t freq;
+    bool gate;
+    int16_t velocity;
+};
+
+static int16_t peak(const int16_t *samples, size_t len) {
+    int16_t max = 0;
+    for (size_t i = 0; i < len; i++) {
+        int16_t mag = samples[i] == INT16_MIN ? INT16_MAX : abs(samples[i]);
+        if (mag > max) max = mag;
+    }
+    return max;
+}
+
+// holds the gate, then renders until the envelopes have played out and the
+// output has been silent for longer than any echo could take to come back,
+// or the tail runs out. returns frames kept, 0 on failure
+static size_t renderJob(struct BatchRun *run, struct Synth *synth, struct BatchHost *host, int16_t *stereo, float holdMs) {
+    const struct BatchMatrix *matrix = run->matrix;
+    size_t holdFrames = holdMs * matrix->sampleRate / 1000;
+    if (holdFrames < 1) holdFrames = 1;
+    size_t end = holdFrames + (size_t) (matrix->tailMs * matrix->sampleRate / 1000);
+    if (end > run->maxFrames) end = run->maxFrames;
+
+    size_t pos = 0;
+    host->gate = true;
+    while (pos < holdFrames) {
+        size_t len = holdFrames - pos < BATCH_BLOCK ? holdFrames - pos : BATCH_BLOCK;
+        synthRunBlockStereo(synth, stereo + 2 * pos, len);
+        pos += len;
+    }
+    host->gate = false;
+    size_t silenceFrames = matrix->silenceMs * matrix->sampleRate / 1000;
+    if (silenceFrames < synthLongestLine(synth)) silenceFrames = synthLongestLine(synth);
+    size_t quietFrames = 0;
+    while (pos < end) {
+        size_t len = end - pos < BATCH_BLOCK ? end - pos : BATCH_BLOCK;
+        synthRunBlockStereo(synth, stereo + 2 * pos, len);
+        pos += len;
+        quietFrames = peak(stereo + 2 * (pos - len), 2 * len) < BATCH_SILENCE ? quietFrames + len : 0;
+        if (synthIsReleased(synth) && quietFrames > silenceFrames) break;
+    }
+    atomic_fetch_add_explicit(&run->framesRendered, pos, memory_order_relaxed);
+
+    while (pos > 0 && peak(stereo + 2 * (pos - 1), 2) < BATCH_SILENCE) pos--;
+    return pos;
+}
+
+static int runJob(struct BatchRun *run, size_t job, int16_t *stereo) {
+    const struct BatchMatrix *matrix = run->matrix;
+    size_t perNote = matrix->velocitiesLen * matrix->holdsLen;
+    int note = matrix->notes[job / perNote];
+    int velocity = matrix->velocities[job / matrix->holdsLen % matrix->velocitiesLen];
+    float holdMs = matrix->holdsMs[job % matrix->holdsLen];
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/n%03d_v%03d_h%gms.wav", run->outDir, note, velocity, holdMs);
+
+    struct BatchHost host = {
+        .freq = freqToSample(440 * powf(2, (note - 69) / 12.0f)),
+        .velocity = floatToAmt(velocity / 127.0f),
+    };
+    struct PatchInput inputs[3 + BATCH_MAX_SHARED] = {
+        { "freq", PORT_Sample, &host.freq },
+        { "gate", PORT_Gate, &host.gate },
+        { "velocity", PORT_Sample, &host.velocity },
+    };
+    memcpy(inputs + 3, run->shared, run->sharedLen * sizeof(struct PatchInput));
+
+    // renders already run one per thread, a nested schedule would only contend
+    struct Synth synth = { .sampleRate = matrix->sampleRate, .maxThreads = 1 };
+    if (patchLoad(&synth, run->bin, run->binLen, inputs, 3 + run->sharedLen) != 0) return -1;
+    if (synthInit(&synth) != 0) {
+        synthDestroy(&synth);
+        return -1;
+    }
+
+    size_t frames = renderJob(run, &synth, &host, stereo, holdMs);
+    int channels = synth.outPtrRight != NULL ? 2 : 1;
+    synthDestroy(&synth);
+
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; i++) stereo[i] = stereo[2 * i];
+    }
+    return writeWav(path, stereo, frames, channels, matrix->sampleRate);
+}
+
+// each thread claims renders until none are left
+static void *batchWorker(void *ctx) {
+    struct BatchRun *run = ctx;
+    int16_t *stereo = malloc(2 * run->maxFrames * sizeof(int16_t));
+
+    for (;;) {
+        size_t job = atomic_fetch_add_explicit(&run->next, 1, memory_order_relaxed);
+        if (job >= run->jobsLen) break;
+        if (stereo == NULL || runJob(run, job, stereo) != 0) {
+            atomic_fetch_add_explicit(&run->failed, 1, memory_order_relaxed);
+        }
+    }
+    free(stereo);
+    return NULL;
+}
+
+static double nowSecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int batchRender(const char *patchPath, const struct BatchMatrix *matrix,
+                const struct PatchInput *shared, size_t sharedLen, const char *outDir, int threads) {
+    if (sharedLen > BATCH_MAX_SHARED) {
+        fprintf(stderr, "batch: too many samples and wavetables\n");
+        return -1;
+    }
+    if (mkdir(outDir, 0777) != 0 && errno != EEXIST) {
+        perror(outDir);
+        return -1;
+    }
+
+    float maxHoldMs = 0;
+    for (size_t i = 0; i < matrix->holdsLen; i++) {
+        if (matrix->holdsMs[i] > maxHoldMs) maxHoldMs = matrix->holdsMs[i];
+    }
+
+    struct BatchRun run = {
+        .matrix = matrix,
+        .shared = shared,
+        .sharedLen = sharedLen,
+        .outDir = outDir,
+        .jobsLen = matrix->notesLen * matrix->velocitiesLen * matrix->holdsLen,
+        .maxFrames = (size_t) ((maxHoldMs + matrix->tailMs) * matrix->sampleRate / 1000) + 1,
+    };
+    void *bin;
+    if (patchReadFile(patchPath, &bin, &run.binLen) != 0) return -1;
+    run.bin = bin;
+
+    // renders don't share anything but the job counter, so these are the
+    // batch's own threads rather than the engine pool and its cap
+    size_t tasks = threads < BATCH_MAX_THREADS ? threads : BATCH_MAX_THREADS;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        tasks = cpus > 0 ? (size_t) cpus : 1;
+    }
+    if (tasks > run.jobsLen) tasks = run.jobsLen;
+    pthread_t *workers = tasks > 1 ? malloc((tasks - 1) * sizeof(pthread_t)) : NULL;
+    if (workers == NULL) tasks = 1;
+
+    double start = nowSecs();
+    // the calling thread is the last worker, a thread that won't start only
+    // leaves its renders to the others
+    size_t started = 0;
+    while (started + 1 < tasks && pthread_create(&workers[started], NULL, batchWorker, &run) == 0) started++;
+    tasks = started + 1;
+    batchWorker(&run);
+    for (size_t i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    double elapsed = nowSecs() - start;
+    free(workers);
+    free(bin);
+
+    double audioSecs = atomic_load(&run.framesRendered) / matrix->sampleRate;
+    int failed = atomic_load(&run.failed);
+    printf("%zu renders, %d failed, %.1f s of audio in %.2f s on %zu threads, %.1fx realtime\n",
+           run.jobsLen, failed, audioSecs, elapsed, tasks, elapsed > 0 ? audioSecs / elapsed : 0);
+    return failed;
+}
@@ -0,0 +1,46 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "patch.h"
+
+#define BATCH_MAX_STEPS 128
+// most render threads -j may ask for
+#define BATCH_MAX_THREADS 1024
+
+// every combination of note, velocity and hold time gets its own render.
+// read from a file of lines like
+//     notes = 21-108
+//     velocities = 32 64 96 127
+//     holdMs = 500 2000
+//     tailMs = 8000
+//     silenceMs = 200
+//     sampleRate = 48000
+struct BatchMatrix {
+    int notes[BATCH_MAX_STEPS];
+    size_t notesLen;
+    int velocities[BATCH_MAX_STEPS];
+    size_t velocitiesLen;
+    float holdsMs[BATCH_MAX_STEPS];
+    size_t holdsLen;
+    // longest anything may ring after the gate is released
+    float tailMs;
+    // how long the output has to stay silent after the release before a
+    // render ends, never less than the patch's longest delay or reverb line
+    float silenceMs;
+    float sampleRate;
+};
+
+int batchLoadMatrix(struct BatchMatrix *matrix, const char *path);
+// renders every combination with its own Synth on up to threads threads (0
+// for one per cpu) into outDir/n<note>_v<velocity>_h<holdMs>.wav. the patch
+// sees the note as @freq, the key as @gate and the velocity as @velocity, and
+// shared lists the host resources (samples, wavetables) it may also use.
+// returns how many renders failed
+int batchRender(const char *patchPath, const struct BatchMatrix *matrix,
+                const struct PatchInput *shared, size_t sharedLen, const char *outDir, int threads);
+
+#endif //BATCH_H
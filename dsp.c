@@ -0,0 +1,339 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DSP_X86
+#include <immintrin.h>
+#endif
+
+#include "dsp.h"
+
+// each variant is built for its own target, the rest of the binary stays at
+// the baseline so it still starts on the oldest host we ship to
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+
+static float genericFirDot(const int16_t *samples, const float *taps, size_t len) {
+    float sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += samples[i] * taps[i];
+    }
+    return sum;
+}
+
+static void genericS16ToF32(const int16_t *in, float *out, size_t len, float scale) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = in[i] * scale;
+    }
+}
+
+static void genericUnisonSaws(float *phase, const float *inc, const float *gainLeft, const float *gainRight,
+                              size_t voices, float *left, float *right) {
+    float sumLeft = 0;
+    float sumRight = 0;
+    for (size_t voice = 0; voice < voices; voice++) {
+        float p = phase[voice] + inc[voice];
+        if (p >= 1) p -= 1;
+        phase[voice] = p;
+
+        // saw with a polyBLEP step correction
+        float saw = 2 * p - 1;
+        if (p < inc[voice]) {
+            float t = p / inc[voice];
+            saw -= t + t - t * t - 1;
+        } else if (p > 1 - inc[voice]) {
+            float t = (p - 1) / inc[voice];
+            saw -= t * t + t + t + 1;
+        }
+        sumLeft += saw * gainLeft[voice];
+        sumRight += saw * gainRight[voice];
+    }
+    *left = sumLeft;
+    *right = sumRight;
+}
+
+#ifdef DSP_X86
+TARGET_SSE2 static __m128 sse2S16LoToF32(__m128i in) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+}
+
+TARGET_SSE2 static __m128 sse2S16HiToF32(__m128i in) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+}
+
+TARGET_SSE2 static float sse2Sum(__m128 v) {
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_SSE2 static float sse2FirDot(const int16_t *samples, const float *taps, size_t len) {
+    __m128 sumLo = _mm_setzero_ps();
+    __m128 sumHi = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i *) (samples + i));
+        sumLo = _mm_add_ps(sumLo, _mm_mul_ps(sse2S16LoToF32(in), _mm_loadu_ps(taps + i)));
+        sumHi = _mm_add_ps(sumHi, _mm_mul_ps(sse2S16HiToF32(in), _mm_loadu_ps(taps + i + 4)));
+    }
+    float sum = sse2Sum(_mm_add_ps(sumLo, sumHi));
+    for (; i < len; i++) {
+        sum += samples[i] * taps[i];
+    }
+    return sum;
+}
+
+TARGET_SSE2 static void sse2S16ToF32(const int16_t *in, float *out, size_t len, float scale) {
+    const __m128 scaleVec = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i samples = _mm_loadu_si128((const __m128i *) (in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(sse2S16LoToF32(samples), scaleVec));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(sse2S16HiToF32(samples), scaleVec));
+    }
+    for (; i < len; i++) {
+        out[i] = in[i] * scale;
+    }
+}
+
+// four voices per iteration
+TARGET_SSE2 static void sse2UnisonSaws(float *phase, const float *inc, const float *gainLeft, const float *gainRight,
+                                       size_t voices, float *left, float *right) {
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 two = _mm_set1_ps(2);
+    __m128 sumLeft = _mm_setzero_ps();
+    __m128 sumRight = _mm_setzero_ps();
+    for (size_t voice = 0; voice < voices; voice += 4) {
+        __m128 dt = _mm_loadu_ps(inc + voice);
+        __m128 p = _mm_add_ps(_mm_loadu_ps(phase + voice), dt);
+        p = _mm_sub_ps(p, _mm_and_ps(_mm_cmpge_ps(p, one), one));
+        _mm_storeu_ps(phase + voice, p);
+
+        __m128 saw = _mm_sub_ps(_mm_mul_ps(two, p), one);
+        __m128 t = _mm_div_ps(p, dt);
+        __m128 blepStart = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(t, t), _mm_mul_ps(t, t)), one);
+        saw = _mm_sub_ps(saw, _mm_and_ps(_mm_cmplt_ps(p, dt), blepStart));
+        t = _mm_div_ps(_mm_sub_ps(p, one), dt);
+        __m128 blepEnd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t, t), _mm_add_ps(t, t)), one);
+        saw = _mm_sub_ps(saw, _mm_and_ps(_mm_cmpgt_ps(p, _mm_sub_ps(one, dt)), blepEnd));
+
+        sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(saw, _mm_loadu_ps(gainLeft + voice)));
+        sumRight = _mm_add_ps(sumRight, _mm_mul_ps(saw, _mm_loadu_ps(gainRight + voice)));
+    }
+    *left = sse2Sum(sumLeft);
+    *right = sse2Sum(sumRight);
+}
+
+TARGET_AVX2 static float avx2Sum(__m256 v) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_AVX2 static __m256 avx2S16ToF32x8(const int16_t *in) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) in)));
+}
+
+TARGET_AVX2 static float avx2FirDot(const int16_t *samples, const float *taps, size_t len) {
+    __m256 sumA = _mm256_setzero_ps();
+    __m256 sumB = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        sumA = _mm256_fmadd_ps(avx2S16ToF32x8(samples + i), _mm256_loadu_ps(taps + i), sumA);
+        sumB = _mm256_fmadd_ps(avx2S16ToF32x8(samples + i + 8), _mm256_loadu_ps(taps + i + 8), sumB);
+    }
+    for (; i + 8 <= len; i += 8) {
+        sumA = _mm256_fmadd_ps(avx2S16ToF32x8(samples + i), _mm256_loadu_ps(taps + i), sumA);
+    }
+    float sum = avx2Sum(_mm256_add_ps(sumA, sumB));
+    for (; i < len; i++) {
+        sum += samples[i] * taps[i];
+    }
+    return sum;
+}
+
+TARGET_AVX2 static void avx2S16ToF32(const int16_t *in, float *out, size_t len, float scale) {
+    const __m256 scaleVec = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(avx2S16ToF32x8(in + i), scaleVec));
+    }
+    for (; i < len; i++) {
+        out[i] = in[i] * scale;
+    }
+}
+
+// eight voices per iteration
+TARGET_AVX2 static void avx2UnisonSaws(float *phase, const float *inc, const float *gainLeft, const float *gainRight,
+                                       size_t voices, float *left, float *right) {
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 two = _mm256_set1_ps(2);
+    __m256 sumLeft = _mm256_setzero_ps();
+    __m256 sumRight = _mm256_setzero_ps();
+    for (size_t voice = 0; voice < voices; voice += 8) {
+        __m256 dt = _mm256_loadu_ps(inc + voice);
+        __m256 p = _mm256_add_ps(_mm256_loadu_ps(phase + voice), dt);
+        p = _mm256_sub_ps(p, _mm256_and_ps(_mm256_cmp_ps(p, one, _CMP_GE_OQ), one));
+        _mm256_storeu_ps(phase + voice, p);
+
+        __m256 saw = _mm256_fmsub_ps(two, p, one);
+        __m256 t = _mm256_div_ps(p, dt);
+        __m256 blepStart = _mm256_sub_ps(_mm256_fnmadd_ps(t, t, _mm256_add_ps(t, t)), one);
+        saw = _mm256_sub_ps(saw, _mm256_and_ps(_mm256_cmp_ps(p, dt, _CMP_LT_OQ), blepStart));
+        t = _mm256_div_ps(_mm256_sub_ps(p, one), dt);
+        __m256 blepEnd = _mm256_add_ps(_mm256_fmadd_ps(t, t, _mm256_add_ps(t, t)), one);
+        saw = _mm256_sub_ps(saw, _mm256_and_ps(_mm256_cmp_ps(p, _mm256_sub_ps(one, dt), _CMP_GT_OQ), blepEnd));
+
+        sumLeft = _mm256_fmadd_ps(saw, _mm256_loadu_ps(gainLeft + voice), sumLeft);
+        sumRight = _mm256_fmadd_ps(saw, _mm256_loadu_ps(gainRight + voice), sumRight);
+    }
+    *left = avx2Sum(sumLeft);
+    *right = avx2Sum(sumRight);
+}
+
+TARGET_AVX512 static __m512 avx512S16ToF32x16(const int16_t *in) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) in)));
+}
+
+TARGET_AVX512 static float avx512FirDot(const int16_t *samples, const float *taps, size_t len) {
+    __m512 sumA = _mm512_setzero_ps();
+    __m512 sumB = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        sumA = _mm512_fmadd_ps(avx512S16ToF32x16(samples + i), _mm512_loadu_ps(taps + i), sumA);
+        sumB = _mm512_fmadd_ps(avx512S16ToF32x16(samples + i + 16), _mm512_loadu_ps(taps + i + 16), sumB);
+    }
+    for (; i + 16 <= len; i += 16) {
+        sumA = _mm512_fmadd_ps(avx512S16ToF32x16(samples + i), _mm512_loadu_ps(taps + i), sumA);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(sumA, sumB));
+    for (; i < len; i++) {
+        sum += samples[i] * taps[i];
+    }
+    return sum;
+}
+
+TARGET_AVX512 static void avx512S16ToF32(const int16_t *in, float *out, size_t len, float scale) {
+    const __m512 scaleVec = _mm512_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(avx512S16ToF32x16(in + i), scaleVec));
+    }
+    for (; i < len; i++) {
+        out[i] = in[i] * scale;
+    }
+}
+
+// every voice in one vector, the lanes past the count carry zero gain
+TARGET_AVX512 static void avx512UnisonSaws(float *phase, const float *inc, const float *gainLeft, const float *gainRight,
+                                           size_t voices, float *left, float *right) {
+    const __m512 one = _mm512_set1_ps(1);
+    const __m512 two = _mm512_set1_ps(2);
+    __m512 sumLeft = _mm512_setzero_ps();
+    __m512 sumRight = _mm512_setzero_ps();
+    for (size_t voice = 0; voice < voices; voice += 16) {
+        __m512 dt = _mm512_loadu_ps(inc + voice);
+        __m512 p = _mm512_add_ps(_mm512_loadu_ps(phase + voice), dt);
+        p = _mm512_mask_sub_ps(p, _mm512_cmp_ps_mask(p, one, _CMP_GE_OQ), p, one);
+        _mm512_storeu_ps(phase + voice, p);
+
+        __m512 saw = _mm512_fmsub_ps(two, p, one);
+        __m512 t = _mm512_div_ps(p, dt);
+        __m512 blepStart = _mm512_sub_ps(_mm512_fnmadd_ps(t, t, _mm512_add_ps(t, t)), one);
+        saw = _mm512_mask_sub_ps(saw, _mm512_cmp_ps_mask(p, dt, _CMP_LT_OQ), saw, blepStart);
+        t = _mm512_div_ps(_mm512_sub_ps(p, one), dt);
+        __m512 blepEnd = _mm512_add_ps(_mm512_fmadd_ps(t, t, _mm512_add_ps(t, t)), one);
+        saw = _mm512_mask_sub_ps(saw, _mm512_cmp_ps_mask(p, _mm512_sub_ps(one, dt), _CMP_GT_OQ), saw, blepEnd);
+
+        sumLeft = _mm512_fmadd_ps(saw, _mm512_loadu_ps(gainLeft + voice), sumLeft);
+        sumRight = _mm512_fmadd_ps(saw, _mm512_loadu_ps(gainRight + voice), sumRight);
+    }
+    *left = _mm512_reduce_add_ps(sumLeft);
+    *right = _mm512_reduce_add_ps(sumRight);
+}
+#endif
+
+static const char *variantNames[DSP_VARIANT_COUNT] = {
+    [DSP_Generic] = "generic",
+    [DSP_Sse2] = "sse2",
+    [DSP_Avx2] = "avx2",
+    [DSP_Avx512] = "avx512",
+};
+
+static const struct DspKernels variants[DSP_VARIANT_COUNT] = {
+    [DSP_Generic] = { genericFirDot, genericS16ToF32, genericUnisonSaws },
+#ifdef DSP_X86
+    [DSP_Sse2] = { sse2FirDot, sse2S16ToF32, sse2UnisonSaws },
+    [DSP_Avx2] = { avx2FirDot, avx2S16ToF32, avx2UnisonSaws },
+    [DSP_Avx512] = { avx512FirDot, avx512S16ToF32, avx512UnisonSaws },
+#endif
+};
+
+// generic until dspInit runs, so a kernel called early is slow but never wrong
+struct DspKernels dsp = { genericFirDot, genericS16ToF32, genericUnisonSaws };
+static enum DspVariant active = DSP_Generic;
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+
+bool dspSupported(enum DspVariant variant) {
+#ifdef DSP_X86
+    __builtin_cpu_init();
+#endif
+    switch (variant) {
+    case DSP_Generic:
+        return true;
+#ifdef DSP_X86
+    case DSP_Sse2:
+        return __builtin_cpu_supports("sse2");
+    case DSP_Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case DSP_Avx512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    default:
+        return false;
+    }
+}
+
+int dspSelect(enum DspVariant variant) {
+    if (variant >= DSP_VARIANT_COUNT || !dspSupported(variant)) return -1;
+    dsp = variants[variant];
+    active = variant;
+    return 0;
+}
+
+enum DspVariant dspVariant(void) {
+    return active;
+}
+
+const char *dspVariantName(enum DspVariant variant) {
+    return variant < DSP_VARIANT_COUNT ? variantNames[variant] : "unknown";
+}
+
+static void dspDetect(void) {
+    enum DspVariant best = DSP_Generic;
+    for (int variant = 0; variant < DSP_VARIANT_COUNT; variant++) {
+        if (dspSupported(variant)) best = variant;
+    }
+
+    const char *forced = getenv("SYNTH_DSP");
+    if (forced != NULL && forced[0] != '\0') {
+        int variant = 0;
+        while (variant < DSP_VARIANT_COUNT && strcmp(forced, variantNames[variant]) != 0) variant++;
+        if (variant == DSP_VARIANT_COUNT) {
+            fprintf(stderr, "dsp: no variant %s, using %s\n", forced, variantNames[best]);
+        } else if (!dspSupported(variant)) {
+            fprintf(stderr, "dsp: this cpu can't run %s, using %s\n", forced, variantNames[best]);
+        } else {
+            best = variant;
+        }
+    }
+    dspSelect(best);
+}
+
+void dspInit(void) {
+    pthread_once(&initOnce, dspDetect);
+}
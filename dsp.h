@@ -0,0 +1,41 @@
+#ifndef DSP_H
+#define DSP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// hot inner loops, compiled once per instruction set and bound at startup so
+// one binary runs the widest vectors each host has
+enum DspVariant {
+    DSP_Generic,
+    DSP_Sse2,
+    DSP_Avx2,
+    DSP_Avx512,
+
+    DSP_VARIANT_COUNT
+};
+
+struct DspKernels {
+    // sum of samples[i] * taps[i]
+    float (*firDot)(const int16_t *samples, const float *taps, size_t len);
+    void (*s16ToF32)(const int16_t *in, float *out, size_t len, float scale);
+    // steps every voice's band-limited saw once and sums them into left and right.
+    // variants run whole vectors, so arrays hold voices rounded up to 16 and the
+    // voices past the count need zero gains
+    void (*unisonSaws)(float *phase, const float *inc, const float *gainLeft, const float *gainRight,
+                       size_t voices, float *left, float *right);
+};
+
+extern struct DspKernels dsp;
+
+// binds the best variant this cpu runs, or the one named by SYNTH_DSP.
+// safe to call from anywhere, only the first call does anything
+void dspInit(void);
+bool dspSupported(enum DspVariant variant);
+// rebinds every kernel, for tests and benchmarks. not while audio is running
+int dspSelect(enum DspVariant variant);
+enum DspVariant dspVariant(void);
+const char *dspVariantName(enum DspVariant variant);
+
+#endif //DSP_H
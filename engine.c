@@ -1,9 +1,25 @@
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "engine.h"
+#include "dsp.h"
+#include "pool.h"
+#include "rtcheck.h"
+#include "fft.h"
+#include "sampler.h"
+#include "wavetable.h"
 
 int16_t floatToAmt(float amt) {
     if (amt >= 1) return INT16_MAX;
@@ -13,11 +29,11 @@ int16_t floatToAmt(float amt) {
 }
 
 int16_t freqToSample(float freq) {
-    return INT16_MAX * logf(freq) / (logf(SAMPLE_RATE / 2.0f - MIDDLE_C_FREQ));
+    return INT16_MAX * logf(freq) / FREQ_SAMPLE_LOG_MAX;
 }
 
 float sampleToFreq(int16_t sample) {
-    return expf(sample * logf(SAMPLE_RATE / 2.0f - MIDDLE_C_FREQ) / INT16_MAX);
+    return expf(sample * (FREQ_SAMPLE_LOG_MAX / INT16_MAX));
 }
 
 float sampleToFloat(int16_t sample, float rangeMin, float rangeMax) {
@@ -174,7 +190,7 @@ void sftTest(void) {
     float freq = 1300;
     float freq2 = 12000;
     float amplitude = 1000;
-    float sampleRate = SAMPLE_RATE;
+    float sampleRate = DEFAULT_SAMPLE_RATE;
     for (int i = 0; i < 128; i++) {
         samples[i] = 
             amplitude
@@ -190,9 +206,47 @@ void sftTest(void) {
     printFourier(fourierSFT, 128, sampleRate);
     printf("\n\n\nfast:\n");
     printFourier(fourierFFT, 128, sampleRate);
+
+    struct FftPlan *plan = fftPlanCreate(128);
+    float realBuf[128];
+    int iters = 1000;
+
+    clock_t start = clock();
+    for (int i = 0; i < iters; i++) {
+        slowFourierTransform(samples, fourierSFT, 128);
+    }
+    double sftSecs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int i = 0; i < iters; i++) {
+        slowFFT(samples, fourierFFT, 128);
+    }
+    double slowFftSecs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int i = 0; i < iters; i++) {
+        for (int n = 0; n < 128; n++) {
+            realBuf[n] = samples[n];
+        }
+        fftRealForward(plan, realBuf);
+    }
+    double realFftSecs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    float maxErr = 0;
+    for (size_t k = 0; k <= 64; k++) {
+        Cplx bin = cplxScale(fftRealBin(plan, realBuf, k), 1.0f / 128);
+        float err = fabsf(bin.real - fourierSFT[k].real) + fabsf(bin.imag - fourierSFT[k].imag);
+        if (err > maxErr) maxErr = err;
+    }
+    fftPlanDestroy(plan);
+
+    printf("\n\n\nbenchmark, %d transforms of 128 samples:\n", iters);
+    printf("slowFourierTransform: %.3f us\n", 1e6 * sftSecs / iters);
+    printf("slowFFT:              %.3f us\n", 1e6 * slowFftSecs / iters);
+    printf("fftRealForward:       %.3f us (max bin error vs slowFourierTransform %g)\n", 1e6 * realFftSecs / iters, maxErr);
 }
 
-static uint64_t nextRand = 42;
+static uint32_t baseSeed = 42;
 
 
 static int16_t mixerRun(struct Mixer *mixer) {
@@ -216,22 +270,22 @@ static int16_t distRun(struct Distortion *distortion) {
     );
 }
 
-void srandqd(int32_t seed) {
-    nextRand = seed;
+// noise state is per module, seeded from the base seed and the module's place in the graph
+void srandqd(uint32_t seed) {
+    baseSeed = seed;
 }
 
-static int16_t randqd(void) {
-    nextRand = 1664525 * nextRand + 1013904223;
-    return nextRand;
+static uint32_t moduleSeed(size_t moduleIdx) {
+    return baseSeed ^ (uint32_t) (moduleIdx * 0x85ebca6bu);
 }
 
-static int16_t oscRun(struct Oscillator *osc) {
+static int16_t oscRun(struct Oscillator *osc, const struct SynthRate *rate) {
     if (*osc->waveform == WAV_Noise) {
-        return randqd();
+        return noiseNext(&osc->_priv.noise);
     }
 
     float freq = sampleToFreq(*osc->freqSample);
-    float period = SAMPLE_RATE / freq;
+    float period = rate->sampleRate / freq;
     int16_t sample = INT16_MIN;
     int16_t amplitude = (*osc->amt - INT16_MIN) / 2;
 
@@ -241,16 +295,16 @@ static int16_t oscRun(struct Oscillator *osc) {
 
     uint32_t tOffset = osc->_priv.t;
     if (osc->phaseOffset != NULL) {
-        tOffset += SAMPLE_RATE * fmodPos(*osc->phaseOffset, 360) / (360 * freq);
+        tOffset += rate->sampleRate * fmodPos(*osc->phaseOffset, 360) / (360 * freq);
         tOffset = tOffset % (uint16_t) period;
     }
 
     switch (*osc->waveform) {
     case WAV_Sine:
-        sample = amplitude * sinf(M_TAU * tOffset * freq / SAMPLE_RATE);
+        sample = amplitude * sinf(rate->radPerFrame * tOffset * freq);
         break;
     case WAV_Square:
-        sample = (tOffset < SAMPLE_RATE / freq / 2 ? -amplitude : amplitude);
+        sample = (tOffset < period / 2 ? -amplitude : amplitude);
         break;
     case WAV_Tri:
         sample = amplitude * 4 * (fabs(fmodf(tOffset, period) - period / 2.0f) - period / 4.0f) / period;
@@ -278,39 +332,11 @@ static int16_t attrRun(struct Attenuator *attr) {
     return *attr->sampleIn * (*attr->amount - INT16_MIN) / (INT16_MAX - INT16_MIN);
 }
 
-static uint32_t msToFrames(float ms) {
-    return ms * SAMPLE_RATE / 1000.0f;
-}
-
-static void printStage(enum EnvelopeStage stage) {
-    switch (stage) {
-    case STAGE_Pending:
-        printf("%s\n", "Pending");
-        break;
-    case STAGE_Attack:
-        printf("%s\n", "Attack");
-        break;
-    case STAGE_Decay:
-        printf("%s\n", "Decay");
-        break;
-    case STAGE_Decay2:
-        printf("%s\n", "Decay2");
-        break;
-    case STAGE_Sustain:
-        printf("%s\n", "Sustain");
-        break;
-    case STAGE_Release:
-        printf("%s\n", "Release");
-        break;
-    case STAGE_Finished:
-        printf("%s\n", "Finished");
-        break;
-    }
+static uint32_t msToFrames(float ms, const struct SynthRate *rate) {
+    return ms * rate->framesPerMs;
 }
 
 static int16_t envAdRun(struct EnvelopeAd *env) {
-    uint32_t attackPeriod = msToFrames(*env->attackMs);
-    uint32_t decayPeriod = msToFrames(*env->decayMs);
     enum EnvelopeStage nextStage = env->_priv.stage;
     int16_t sample = INT16_MIN;
 
@@ -321,14 +347,14 @@ static int16_t envAdRun(struct EnvelopeAd *env) {
         }
         break;
     case STAGE_Attack:
-        sample = tToRangeEased(env->_priv.t, 0, attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
-        if (++env->_priv.t > attackPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
+        if (++env->_priv.t > env->_priv.attackPeriod) {
             nextStage = STAGE_Decay;
         }
         break;
     case STAGE_Decay:
-        sample = tToRangeEased(env->_priv.t, 0, decayPeriod, INT16_MAX, INT16_MIN, *env->easing);
-        if (++env->_priv.t > decayPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.decayPeriod, INT16_MAX, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.decayPeriod) {
             nextStage = STAGE_Finished;
         }
         break;
@@ -350,8 +376,6 @@ static int16_t envAdRun(struct EnvelopeAd *env) {
 }
 
 static int16_t envArRun(struct EnvelopeAr *env) {
-    uint32_t attackPeriod = msToFrames(*env->attackMs);
-    uint32_t releasePeriod = msToFrames(*env->releaseMs);
     enum EnvelopeStage nextStage = env->_priv.stage;
     int16_t sample = INT16_MIN;
 
@@ -362,8 +386,8 @@ static int16_t envArRun(struct EnvelopeAr *env) {
         }
         break;
     case STAGE_Attack:
-        sample = tToRangeEased(env->_priv.t, 0, attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
-        if (++env->_priv.t > attackPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
+        if (++env->_priv.t > env->_priv.attackPeriod) {
             nextStage = STAGE_Sustain;
         }
         break;
@@ -374,8 +398,8 @@ static int16_t envArRun(struct EnvelopeAr *env) {
         }
         break;
     case STAGE_Release:
-        sample = tToRangeEased(env->_priv.t, 0, releasePeriod, INT16_MAX, INT16_MIN, *env->easing);
-        if (++env->_priv.t > releasePeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.releasePeriod, INT16_MAX, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.releasePeriod) {
             nextStage = STAGE_Pending;
         }
         if (*env->gate == true) {
@@ -394,14 +418,9 @@ static int16_t envArRun(struct EnvelopeAr *env) {
 }
 
 static int16_t envAdrRun(struct EnvelopeAdr *env) {
-    uint32_t attackPeriod = msToFrames(*env->attackMs);
-    uint32_t decayPeriod = msToFrames(*env->decayMs);
-    uint32_t releasePeriod = msToFrames(*env->releaseMs);
     enum EnvelopeStage nextStage = env->_priv.stage;
     int16_t sample = INT16_MIN;
 
-    printStage(env->_priv.stage);
-
     switch (env->_priv.stage) {
     case STAGE_Pending:
         if (*env->gate == true) {
@@ -409,8 +428,8 @@ static int16_t envAdrRun(struct EnvelopeAdr *env) {
         }
         break;
     case STAGE_Attack:
-        sample = tToRangeEased(env->_priv.t, 0, attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
-        if (++env->_priv.t > attackPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
+        if (++env->_priv.t > env->_priv.attackPeriod) {
             nextStage = STAGE_Decay;
         }
         if (*env->gate == false) {
@@ -419,8 +438,8 @@ static int16_t envAdrRun(struct EnvelopeAdr *env) {
         }
         break;
     case STAGE_Decay:
-        sample = tToRangeEased(env->_priv.t, 0, decayPeriod, INT16_MAX, INT16_MIN, *env->easing);
-        if (++env->_priv.t > decayPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.decayPeriod, INT16_MAX, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.decayPeriod) {
             nextStage = STAGE_Finished;
         }
         if (*env->gate == false) {
@@ -429,8 +448,8 @@ static int16_t envAdrRun(struct EnvelopeAdr *env) {
         }
         break;
     case STAGE_Release:
-        sample = tToRangeEased(env->_priv.t, 0, releasePeriod, env->_priv.releaseSample, INT16_MIN, *env->easing);
-        if (++env->_priv.t > releasePeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.releasePeriod, env->_priv.releaseSample, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.releasePeriod) {
             nextStage = STAGE_Pending;
         }
         if (*env->gate == true) {
@@ -454,9 +473,6 @@ static int16_t envAdrRun(struct EnvelopeAdr *env) {
 }
 
 static int16_t envAdsrRun(struct EnvelopeAdsr *env) {
-    uint32_t attackPeriod = msToFrames(*env->attackMs);
-    uint32_t decayPeriod = msToFrames(*env->decayMs);
-    uint32_t releasePeriod = msToFrames(*env->releaseMs);
     enum EnvelopeStage nextStage = env->_priv.stage;
     int16_t sample = INT16_MIN;
 
@@ -467,8 +483,8 @@ static int16_t envAdsrRun(struct EnvelopeAdsr *env) {
         }
         break;
     case STAGE_Attack:
-        sample = tToRangeEased(env->_priv.t, 0, attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
-        if (++env->_priv.t > attackPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
+        if (++env->_priv.t > env->_priv.attackPeriod) {
             nextStage = STAGE_Decay;
         }
         if (*env->gate == false) {
@@ -477,8 +493,8 @@ static int16_t envAdsrRun(struct EnvelopeAdsr *env) {
         }
         break;
     case STAGE_Decay:
-        sample = tToRangeEased(env->_priv.t, 0, decayPeriod, INT16_MAX, *env->sustain, *env->easing);
-        if (++env->_priv.t > decayPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.decayPeriod, INT16_MAX, *env->sustain, *env->easing);
+        if (++env->_priv.t > env->_priv.decayPeriod) {
             nextStage = STAGE_Sustain;
         }
         if (*env->gate == false) {
@@ -494,8 +510,8 @@ static int16_t envAdsrRun(struct EnvelopeAdsr *env) {
         }
         break;
     case STAGE_Release:
-        sample = tToRangeEased(env->_priv.t, 0, releasePeriod, env->_priv.releaseSample, INT16_MIN, *env->easing);
-        if (++env->_priv.t > releasePeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.releasePeriod, env->_priv.releaseSample, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.releasePeriod) {
             nextStage = STAGE_Pending;
         }
         if (*env->gate == true) {
@@ -514,10 +530,6 @@ static int16_t envAdsrRun(struct EnvelopeAdsr *env) {
 }
 
 static int16_t envAdbdrRun(struct EnvelopeAdbdr *env) {
-    uint32_t attackPeriod = msToFrames(*env->attackMs);
-    uint32_t decay1Period = msToFrames(*env->decay1Ms);
-    uint32_t decay2Period = msToFrames(*env->decay2Ms);
-    uint32_t releasePeriod = msToFrames(*env->releaseMs);
     enum EnvelopeStage nextStage = env->_priv.stage;
     int16_t sample = INT16_MIN;
 
@@ -528,8 +540,8 @@ static int16_t envAdbdrRun(struct EnvelopeAdbdr *env) {
         }
         break;
     case STAGE_Attack:
-        sample = tToRangeEased(env->_priv.t, 0, attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
-        if (++env->_priv.t > attackPeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.attackPeriod, INT16_MIN, INT16_MAX, *env->easing);
+        if (++env->_priv.t > env->_priv.attackPeriod) {
             nextStage = STAGE_Decay;
         }
         if (*env->gate == false) {
@@ -538,8 +550,8 @@ static int16_t envAdbdrRun(struct EnvelopeAdbdr *env) {
         }
         break;
     case STAGE_Decay:
-        sample = tToRangeEased(env->_priv.t, 0, decay1Period, INT16_MAX, *env->breakPoint, *env->easing);
-        if (++env->_priv.t > decay1Period) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.decay1Period, INT16_MAX, *env->breakPoint, *env->easing);
+        if (++env->_priv.t > env->_priv.decay1Period) {
             nextStage = STAGE_Decay2;
         }
         if (*env->gate == false) {
@@ -548,8 +560,8 @@ static int16_t envAdbdrRun(struct EnvelopeAdbdr *env) {
         }
         break;
     case STAGE_Decay2:
-        sample = tToRangeEased(env->_priv.t, 0, decay2Period, *env->breakPoint, INT16_MIN, *env->easing);
-        if (++env->_priv.t > decay2Period) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.decay2Period, *env->breakPoint, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.decay2Period) {
             nextStage = STAGE_Finished;
         }
         if (*env->gate == false) {
@@ -558,8 +570,8 @@ static int16_t envAdbdrRun(struct EnvelopeAdbdr *env) {
         }
         break;
     case STAGE_Release:
-        sample = tToRangeEased(env->_priv.t, 0, releasePeriod, env->_priv.releaseSample, INT16_MIN, *env->easing);
-        if (++env->_priv.t > releasePeriod) {
+        sample = tToRangeEased(env->_priv.t, 0, env->_priv.releasePeriod, env->_priv.releaseSample, INT16_MIN, *env->easing);
+        if (++env->_priv.t > env->_priv.releasePeriod) {
             nextStage = STAGE_Pending;
         }
         if (*env->gate == true) {
@@ -616,7 +628,7 @@ static void blackmanWindow(float *windowBuf, size_t impulseLen) {
     }
 }
 
-static void createFirWindow(float windowBuf[FILTER_BUF_SIZE], enum FirWindowType window, size_t impulseLen) {
+void createFirWindow(float *windowBuf, enum FirWindowType window, size_t impulseLen) {
     switch (window) {
     case WINDOW_Rectangular:
         rectangularWindow(windowBuf, impulseLen);
@@ -636,97 +648,1900 @@ static void createFirWindow(float windowBuf[FILTER_BUF_SIZE], enum FirWindowType
     }
 }
 
-static int16_t filterRun(struct Filter *filter) {
-    filter->_priv.samplesBuf[filter->_priv.samplesBufIdx] = *filter->sampleIn;
-    if (++filter->_priv.samplesBufIdx == filter->impulseLen) {
+static void filterUpdateImpulse(struct Filter *filter, const struct SynthRate *rate) {
+    float cutoffFreq = sampleToFreq(*filter->cutoff);
+    float responseSum = 0;
+
+    for (size_t i = 0; i < filter->impulseLen; i++) {
+        float nextImpulse =
+            filter->_priv.windowBuf[i]
+            * sinc(
+                rate->radPerFrame * cutoffFreq
+                * (i - (filter->impulseLen - 1) / 2.0f));
+
+        // stored newest-last to line up with the sample ring
+        filter->_priv.impulseResponse[filter->impulseLen - 1 - i] = nextImpulse;
+        responseSum += nextImpulse;
+    }
+
+    for (size_t i = 0; i < filter->impulseLen; i++) {
+        filter->_priv.impulseResponse[i] /= responseSum;
+    }
+}
+
+static int16_t filterRun(struct Filter *filter, const struct SynthRate *rate) {
+    int16_t sampleIn = *filter->sampleIn;
+    size_t len = filter->impulseLen;
+    // the ring is written twice over, so the last impulseLen samples always
+    // sit contiguous from samplesBufIdx, oldest first
+    filter->_priv.samplesBuf[filter->_priv.samplesBufIdx] = sampleIn;
+    filter->_priv.samplesBuf[filter->_priv.samplesBufIdx + len] = sampleIn;
+    if (sampleIn != filter->_priv.lastIn) {
+        filter->_priv.lastIn = sampleIn;
+        filter->_priv.quietLen = 1;
+    } else if (filter->_priv.quietLen < len) {
+        filter->_priv.quietLen++;
+    }
+    if (++filter->_priv.samplesBufIdx == len) {
         filter->_priv.samplesBufIdx = 0;
     }
 
     // generate impulse response
     if (*filter->cutoff != filter->_priv.prevCutoff) {
-        float cutoffFreq = sampleToFreq(*filter->cutoff);
-        float responseSum = 0;
+        filterUpdateImpulse(filter, rate);
+    }
+
+    float sampleOut = dsp.firDot(filter->_priv.samplesBuf + filter->_priv.samplesBufIdx, filter->_priv.impulseResponse, len);
+
+    filter->_priv.prevCutoff = *filter->cutoff;
+    return sampleOut;
+}
+
+static float samplerFrameAt(const struct SampleData *sample, ptrdiff_t frame) {
+    if (frame < 0) frame = 0;
+    if ((size_t) frame >= sample->framesLen) frame = sample->framesLen - 1;
+    return sampleFrame(sample, frame);
+}
+
+static int16_t samplerRun(struct Sampler *sampler, const struct SynthRate *rate) {
+    struct SampleData *sample = sampler->sample;
+
+    // one-shot: a rising gate restarts playback, which runs to the end of the file
+    if (*sampler->gate && !sampler->_priv.prevGate) {
+        sampler->_priv.pos = 0;
+        sampler->_priv.isPlaying = true;
+    }
+    sampler->_priv.prevGate = *sampler->gate;
+
+    size_t idx = sampler->_priv.pos;
+    if (!sampler->_priv.isPlaying || idx >= sample->framesLen) {
+        sampler->_priv.isPlaying = false;
+        return 0;
+    }
+
+    // 4-point cubic hermite between idx and idx + 1
+    float t = sampler->_priv.pos - idx;
+    float y0 = samplerFrameAt(sample, idx - 1);
+    float y1 = samplerFrameAt(sample, idx);
+    float y2 = samplerFrameAt(sample, idx + 1);
+    float y3 = samplerFrameAt(sample, idx + 2);
+    float c1 = 0.5f * (y2 - y0);
+    float c2 = y0 - 2.5f * y1 + 2 * y2 - 0.5f * y3;
+    float c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+    float value = ((c3 * t + c2) * t + c1) * t + y1;
+
+    float rootFreq = sampler->rootFreq != NULL ? *sampler->rootFreq : MIDDLE_C_FREQ;
+    sampler->_priv.pos += sampleToFreq(*sampler->freqSample) / rootFreq * sample->sampleRate / rate->sampleRate;
+
+    int16_t amplitude = (*sampler->amt - INT16_MIN) / 2;
+    value = value * amplitude / INT16_MAX;
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return value;
+}
+
+// the highest mipmap level whose harmonics all stay below nyquist at freq
+static void wavetableUpdatePitch(struct WavetableOsc *osc, const struct SynthRate *rate) {
+    float freq = sampleToFreq(*osc->freqSample);
+    float harmonics = rate->sampleRate / 2 / freq;
+    size_t level = 0;
+    while (level < WAVETABLE_LEVELS - 1 && ((WAVETABLE_FRAME_LEN / 2) >> level) > harmonics) {
+        level++;
+    }
+
+    osc->_priv.level = level;
+    osc->_priv.phaseInc = freq / rate->sampleRate;
+    osc->_priv.prevFreqSample = *osc->freqSample;
+}
+
+static float wavetableLookup(const float *table, float phase) {
+    float idx = phase * WAVETABLE_FRAME_LEN;
+    size_t i0 = idx;
+    size_t i1 = (i0 + 1) & (WAVETABLE_FRAME_LEN - 1);
+    float t = idx - i0;
+    return table[i0] + (table[i1] - table[i0]) * t;
+}
+
+static int16_t wavetableRun(struct WavetableOsc *osc, const struct SynthRate *rate) {
+    const struct WavetableBank *bank = osc->bank;
 
-        for (size_t i = 0; i < filter->impulseLen; i++) {
-            float nextImpulse =
-                filter->_priv.windowBuf[i]
-                * sinc(
-                    M_TAU * cutoffFreq / SAMPLE_RATE
-                    * (i - (filter->impulseLen - 1) / 2.0f));
+    if (!osc->_priv.isInit || *osc->freqSample != osc->_priv.prevFreqSample) {
+        wavetableUpdatePitch(osc, rate);
+        osc->_priv.isInit = true;
+    }
+
+    // crossfade between the two frames either side of the position
+    float framePos = (*osc->position - INT16_MIN) / (float) UINT16_MAX * (bank->framesLen - 1);
+    size_t frame = framePos;
+    if (frame >= bank->framesLen - 1) frame = bank->framesLen > 1 ? bank->framesLen - 2 : 0;
+    float frameT = bank->framesLen > 1 ? framePos - frame : 0;
+
+    float value = wavetableLookup(wavetableFrame(bank, osc->_priv.level, frame), osc->_priv.phase);
+    if (frameT > 0) {
+        float next = wavetableLookup(wavetableFrame(bank, osc->_priv.level, frame + 1), osc->_priv.phase);
+        value += (next - value) * frameT;
+    }
+
+    osc->_priv.phase += osc->_priv.phaseInc;
+    if (osc->_priv.phase >= 1) osc->_priv.phase -= floorf(osc->_priv.phase);
+
+    int16_t amplitude = (*osc->amt - INT16_MIN) / 2;
+    value *= amplitude;
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return value;
+}
 
-            filter->_priv.impulseResponse[i] = nextImpulse;
-            responseSum += nextImpulse;
+static int16_t noiseRun(struct Noise *noise, const struct SynthRate *rate) {
+    int16_t white = noiseNext(&noise->_priv.gen);
+    float value;
+
+    switch (*noise->color) {
+    case NOISE_Pink: {
+        // paul kellet's refined -3dB/octave filter
+        float *b = noise->_priv.pink;
+        b[0] = 0.99886f * b[0] + white * 0.0555179f;
+        b[1] = 0.99332f * b[1] + white * 0.0750759f;
+        b[2] = 0.96900f * b[2] + white * 0.1538520f;
+        b[3] = 0.86650f * b[3] + white * 0.3104856f;
+        b[4] = 0.55000f * b[4] + white * 0.5329522f;
+        b[5] = -0.7616f * b[5] - white * 0.0168980f;
+        value = 0.11f * (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + white * 0.5362f);
+        b[6] = white * 0.115926f;
+        break;
+    }
+    case NOISE_Band: {
+        float freq = noise->freqSample != NULL ? sampleToFreq(*noise->freqSample) : MIDDLE_C_FREQ;
+        noise->_priv.bandPhase += freq / rate->sampleRate;
+        if (noise->_priv.bandPhase >= 1) {
+            noise->_priv.bandPhase -= floorf(noise->_priv.bandPhase);
+            noise->_priv.bandPrev = noise->_priv.bandNext;
+            noise->_priv.bandNext = white;
         }
+        value = noise->_priv.bandPrev + (noise->_priv.bandNext - noise->_priv.bandPrev) * noise->_priv.bandPhase;
+        break;
+    }
+    default:
+        value = white;
+        break;
+    }
+
+    int16_t amplitude = (*noise->amt - INT16_MIN) / 2;
+    value = value * amplitude / INT16_MAX;
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return value;
+}
 
-        for (size_t i = 0; i < filter->impulseLen; i++) {
-            filter->_priv.impulseResponse[i] /= responseSum;
+// position of a voice across the stack, -1 for the lowest to 1 for the highest
+static float unisonVoicePos(size_t voice, size_t voices) {
+    return voices > 1 ? 2.0f * voice / (voices - 1) - 1 : 0;
+}
+
+static void unisonUpdatePitch(struct Unison *unison, size_t voices, const struct SynthRate *rate) {
+    float freq = sampleToFreq(*unison->freqSample);
+    float cents = sampleToFloat(*unison->detune, 0, UNISON_MAX_DETUNE_CENTS);
+
+    for (size_t voice = 0; voice < voices; voice++) {
+        float ratio = exp2f(unisonVoicePos(voice, voices) * cents / 1200);
+        float inc = freq * ratio / rate->sampleRate;
+        unison->_priv.phaseInc[voice] = inc < 0.5f ? inc : 0.5f;
+    }
+    // unused SIMD lanes still run, keep them finite, their gains are zero
+    for (size_t voice = voices; voice < UNISON_MAX_VOICES; voice++) {
+        unison->_priv.phaseInc[voice] = 0.25f;
+    }
+    unison->_priv.prevFreqSample = *unison->freqSample;
+    unison->_priv.prevDetune = *unison->detune;
+}
+
+static void unisonUpdateGains(struct Unison *unison, size_t voices) {
+    float spread = sampleToFloat(*unison->spread, 0, 1);
+    float width = sampleToFloat(*unison->width, 0, 1);
+    float amplitude = (*unison->amt - INT16_MIN) / 2;
+    float weights[UNISON_MAX_VOICES];
+    float power = 0;
+
+    for (size_t voice = 0; voice < voices; voice++) {
+        float pos = fabsf(unisonVoicePos(voice, voices));
+        weights[voice] = (1 - pos) * (1 - spread) + spread;
+        power += weights[voice] * weights[voice];
+    }
+    // two voices with no spread both sit at the edges where the weight is 0,
+    // play them equally rather than dividing by nothing
+    if (power <= 0) {
+        for (size_t voice = 0; voice < voices; voice++) weights[voice] = 1;
+        power = voices;
+    }
+
+    // detuned voices add up as uncorrelated signals, so normalise by power
+    float norm = amplitude / sqrtf(power);
+    for (size_t voice = 0; voice < voices; voice++) {
+        // neighbours in pitch go to opposite sides, equal-power pan law
+        float pan = (voice & 1 ? -1 : 1) * fabsf(unisonVoicePos(voice, voices)) * width;
+        float angle = (pan + 1) * (float) M_TAU / 8;
+        unison->_priv.gainLeft[voice] = weights[voice] * norm * cosf(angle) * 1.41421356f;
+        unison->_priv.gainRight[voice] = weights[voice] * norm * sinf(angle) * 1.41421356f;
+    }
+    for (size_t voice = voices; voice < UNISON_MAX_VOICES; voice++) {
+        unison->_priv.gainLeft[voice] = 0;
+        unison->_priv.gainRight[voice] = 0;
+    }
+
+    unison->_priv.prevAmt = *unison->amt;
+    unison->_priv.prevSpread = *unison->spread;
+    unison->_priv.prevWidth = *unison->width;
+}
+
+static int16_t clampSample(float value) {
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return value;
+}
+
+static int16_t unisonRun(struct Unison *unison, const struct SynthRate *rate) {
+    size_t voices = unison->voices;
+    if (voices < 1) voices = 1;
+    if (voices > UNISON_MAX_VOICES) voices = UNISON_MAX_VOICES;
+
+    if (!unison->_priv.isInit) {
+        // fixed golden ratio phases, so voices don't start in sync but renders repeat
+        for (size_t voice = 0; voice < UNISON_MAX_VOICES; voice++) {
+            unison->_priv.phase[voice] = fmodf(voice * 0.61803399f, 1);
         }
+        unisonUpdatePitch(unison, voices, rate);
+        unisonUpdateGains(unison, voices);
+        unison->_priv.isInit = true;
+    }
+    if (*unison->freqSample != unison->_priv.prevFreqSample || *unison->detune != unison->_priv.prevDetune) {
+        unisonUpdatePitch(unison, voices, rate);
+    }
+    if (*unison->amt != unison->_priv.prevAmt || *unison->spread != unison->_priv.prevSpread
+        || *unison->width != unison->_priv.prevWidth) {
+        unisonUpdateGains(unison, voices);
     }
 
-    float sampleOut = 0;
-    size_t sumIdx = filter->_priv.samplesBufIdx;
+    float left;
+    float right;
+    dsp.unisonSaws(unison->_priv.phase, unison->_priv.phaseInc, unison->_priv.gainLeft, unison->_priv.gainRight,
+                   voices, &left, &right);
 
-    for (size_t i = 0; i < filter->impulseLen; i++) {
-        if (--sumIdx == SIZE_MAX) {
-            sumIdx = filter->impulseLen - 1;
+    unison->outLeft = clampSample(left);
+    unison->outRight = clampSample(right);
+    return clampSample((left + right) / 2);
+}
+
+static int16_t delayRun(struct Delay *delay, const struct SynthRate *rate) {
+    float in = *delay->sampleIn;
+    float *buf = delay->_priv.buf;
+    if (buf == NULL) return in;
+
+    size_t mask = delay->_priv.mask;
+    size_t writeIdx = delay->_priv.writeIdx;
+
+    float target = sampleToFloat(*delay->time, 0, delay->maxTimeMs) * rate->framesPerMs;
+    if (target < 1) target = 1;
+    if (target > mask - 1) target = mask - 1;
+    // a one-pole glide turns time changes into a pitch bend instead of a click
+    delay->_priv.delayFrames += (target - delay->_priv.delayFrames) * 0.001f;
+
+    float delayFrames = delay->_priv.delayFrames;
+    size_t whole = delayFrames;
+    float frac = delayFrames - whole;
+    float a = buf[(writeIdx - whole) & mask];
+    float b = buf[(writeIdx - whole - 1) & mask];
+    float wet = a + (b - a) * frac;
+
+    float feedback = sampleToFloat(*delay->feedback, 0, DELAY_MAX_FEEDBACK);
+    buf[writeIdx & mask] = in + wet * feedback;
+    delay->_priv.writeIdx = writeIdx + 1;
+
+    float mix = sampleToFloat(*delay->mix, 0, 1);
+    return clampSample(in * (1 - mix) + wet * mix);
+}
+
+// base line lengths, mutually prime-ish so the modes don't pile up
+static const float reverbLineMs[REVERB_MAX_LINES] = {
+    29.7f, 37.1f, 41.1f, 43.7f, 47.9f, 53.3f, 59.9f, 61.3f,
+    67.1f, 71.9f, 73.3f, 79.7f, 83.9f, 89.3f, 97.1f, 101.3f,
+};
+
+static size_t reverbLines(const struct Reverb *reverb) {
+    return reverb->lines > 8 ? 16 : 8;
+}
+
+static void reverbUpdateLines(struct Reverb *reverb, const struct SynthRate *rate) {
+    size_t lines = reverbLines(reverb);
+    float roomSize = *reverb->roomSize;
+    if (roomSize < 0.1f) roomSize = 0.1f;
+    if (roomSize > REVERB_MAX_SIZE) roomSize = REVERB_MAX_SIZE;
+    float decayFrames = fmaxf(*reverb->decayMs, 1) * rate->framesPerMs;
+
+    for (size_t line = 0; line < lines; line++) {
+        // with 8 lines take every other length so they still span the range
+        float ms = reverbLineMs[line * (REVERB_MAX_LINES / lines)] * roomSize;
+        size_t delay = ms * rate->framesPerMs;
+        if (delay > reverb->_priv.mask) delay = reverb->_priv.mask;
+        reverb->_priv.delay[line] = delay;
+        reverb->_priv.gain[line] = powf(10, -3.0f * delay / decayFrames);
+    }
+}
+
+// in-place fast walsh-hadamard transform, scaled so the mix stays lossless
+static void hadamard(float *x, size_t len) {
+    float scale = 1 / sqrtf(len);
+#ifdef __SSE2__
+    __m128 v[REVERB_MAX_LINES / 4];
+    size_t vecs = len / 4;
+    const __m128 signs1 = _mm_setr_ps(1, -1, 1, -1);
+    const __m128 signs2 = _mm_setr_ps(1, 1, -1, -1);
+
+    for (size_t i = 0; i < vecs; i++) {
+        __m128 a = _mm_loadu_ps(x + 4 * i);
+        a = _mm_add_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_mul_ps(a, signs1));
+        a = _mm_add_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)), _mm_mul_ps(a, signs2));
+        v[i] = a;
+    }
+    for (size_t h = 1; h < vecs; h *= 2) {
+        for (size_t i = 0; i < vecs; i += 2 * h) {
+            for (size_t j = i; j < i + h; j++) {
+                __m128 a = v[j];
+                v[j] = _mm_add_ps(a, v[j + h]);
+                v[j + h] = _mm_sub_ps(a, v[j + h]);
+            }
+        }
+    }
+    for (size_t i = 0; i < vecs; i++) {
+        _mm_storeu_ps(x + 4 * i, _mm_mul_ps(v[i], _mm_set1_ps(scale)));
+    }
+#else
+    for (size_t h = 1; h < len; h *= 2) {
+        for (size_t i = 0; i < len; i += 2 * h) {
+            for (size_t j = i; j < i + h; j++) {
+                float a = x[j];
+                x[j] = a + x[j + h];
+                x[j + h] = a - x[j + h];
+            }
         }
-        sampleOut += filter->_priv.samplesBuf[sumIdx] * filter->_priv.impulseResponse[i];
     }
+    for (size_t i = 0; i < len; i++) {
+        x[i] *= scale;
+    }
+#endif
+}
 
-    filter->_priv.prevCutoff = *filter->cutoff;
-    return sampleOut;
+static int16_t reverbRun(struct Reverb *reverb) {
+    float in = *reverb->sampleIn;
+    float *buf = reverb->_priv.buf;
+    if (buf == NULL) {
+        reverb->outLeft = reverb->outRight = in;
+        return in;
+    }
+
+    size_t lines = reverbLines(reverb);
+    size_t mask = reverb->_priv.mask;
+    size_t lineLen = mask + 1;
+    size_t writeIdx = reverb->_priv.writeIdx;
+    float damping = sampleToFloat(*reverb->damping, 0, 0.95f);
+    float taps[REVERB_MAX_LINES];
+    float left = 0;
+    float right = 0;
+
+    for (size_t line = 0; line < lines; line++) {
+        float tap = buf[line * lineLen + ((writeIdx - reverb->_priv.delay[line]) & mask)];
+        float *lowpass = &reverb->_priv.lowpass[line];
+        *lowpass = tap + (*lowpass - tap) * damping;
+        taps[line] = *lowpass * reverb->_priv.gain[line];
+
+        // different sign patterns per side keep the two outputs decorrelated
+        left += line & 1 ? -tap : tap;
+        right += line & 2 ? -tap : tap;
+    }
+
+    hadamard(taps, lines);
+    for (size_t line = 0; line < lines; line++) {
+        buf[line * lineLen + (writeIdx & mask)] = in + taps[line];
+    }
+    reverb->_priv.writeIdx = writeIdx + 1;
+
+    float mix = sampleToFloat(*reverb->mix, 0, 1);
+    float wetScale = mix / sqrtf(lines);
+    reverb->outLeft = clampSample(in * (1 - mix) + left * wetScale);
+    reverb->outRight = clampSample(in * (1 - mix) + right * wetScale);
+    return (reverb->outLeft + reverb->outRight) / 2;
+}
+
+static size_t delayLineLen(float ms, const struct SynthRate *rate) {
+    size_t frames = ms * rate->framesPerMs + 2;
+    size_t len = 1;
+    while (len < frames) len *= 2;
+    return len;
+}
+
+#define ARR_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define PORT(T, field, kind) { #field, kind, offsetof(struct T, field), false, 0 }
+#define PORT_OPT(T, field, kind) { #field, kind, offsetof(struct T, field), true, 0 }
+#define PORT_MAX(T, field, kind, max) { #field, kind, offsetof(struct T, field), false, max }
+
+static const struct ModulePort oscillatorPorts[] = {
+    PORT(Oscillator, freqSample, PORT_Sample),
+    PORT(Oscillator, amt, PORT_Sample),
+    PORT(Oscillator, waveform, PORT_Sample),
+    PORT_OPT(Oscillator, phaseOffset, PORT_Float),
+};
+
+static const struct ModulePort envelopeAdPorts[] = {
+    PORT(EnvelopeAd, gate, PORT_Gate),
+    PORT(EnvelopeAd, attackMs, PORT_Float),
+    PORT(EnvelopeAd, decayMs, PORT_Float),
+    PORT(EnvelopeAd, easing, PORT_Float),
+};
+
+static const struct ModulePort envelopeArPorts[] = {
+    PORT(EnvelopeAr, gate, PORT_Gate),
+    PORT(EnvelopeAr, attackMs, PORT_Float),
+    PORT(EnvelopeAr, releaseMs, PORT_Float),
+    PORT(EnvelopeAr, easing, PORT_Float),
+};
+
+static const struct ModulePort envelopeAdrPorts[] = {
+    PORT(EnvelopeAdr, gate, PORT_Gate),
+    PORT(EnvelopeAdr, attackMs, PORT_Float),
+    PORT(EnvelopeAdr, decayMs, PORT_Float),
+    PORT(EnvelopeAdr, releaseMs, PORT_Float),
+    PORT(EnvelopeAdr, easing, PORT_Float),
+};
+
+static const struct ModulePort envelopeAdsrPorts[] = {
+    PORT(EnvelopeAdsr, gate, PORT_Gate),
+    PORT(EnvelopeAdsr, attackMs, PORT_Float),
+    PORT(EnvelopeAdsr, decayMs, PORT_Float),
+    PORT(EnvelopeAdsr, sustain, PORT_Float),
+    PORT(EnvelopeAdsr, releaseMs, PORT_Float),
+    PORT(EnvelopeAdsr, easing, PORT_Float),
+};
+
+static const struct ModulePort envelopeAdbdrPorts[] = {
+    PORT(EnvelopeAdbdr, gate, PORT_Gate),
+    PORT(EnvelopeAdbdr, attackMs, PORT_Float),
+    PORT(EnvelopeAdbdr, decay1Ms, PORT_Float),
+    PORT(EnvelopeAdbdr, breakPoint, PORT_Float),
+    PORT(EnvelopeAdbdr, decay2Ms, PORT_Float),
+    PORT(EnvelopeAdbdr, releaseMs, PORT_Float),
+    PORT(EnvelopeAdbdr, easing, PORT_Float),
+};
+
+static const struct ModulePort amplifierPorts[] = {
+    PORT(Amplifier, sampleIn, PORT_Sample),
+    PORT(Amplifier, gain, PORT_Float),
+};
+
+static const struct ModulePort distortionPorts[] = {
+    PORT(Distortion, sampleIn, PORT_Sample),
+    PORT(Distortion, slope, PORT_Float),
+};
+
+static const struct ModulePort attenuatorPorts[] = {
+    PORT(Attenuator, sampleIn, PORT_Sample),
+    PORT(Attenuator, amount, PORT_Sample),
+};
+
+static const struct ModulePort mixerPorts[] = {
+    PORT(Mixer, samplesIn, PORT_SampleList),
+};
+
+static const struct ModulePort filterPorts[] = {
+    PORT(Filter, sampleIn, PORT_Sample),
+    PORT(Filter, cutoff, PORT_Sample),
+    PORT_MAX(Filter, impulseLen, PORT_Size, FILTER_BUF_SIZE),
+    PORT_OPT(Filter, window, PORT_Window),
+};
+
+static const struct ModulePort samplerPorts[] = {
+    PORT(Sampler, sample, PORT_SampleData),
+    PORT(Sampler, gate, PORT_Gate),
+    PORT(Sampler, freqSample, PORT_Sample),
+    PORT(Sampler, amt, PORT_Sample),
+    PORT_OPT(Sampler, rootFreq, PORT_Float),
+};
+
+static const struct ModulePort wavetableOscPorts[] = {
+    PORT(WavetableOsc, bank, PORT_Wavetable),
+    PORT(WavetableOsc, freqSample, PORT_Sample),
+    PORT(WavetableOsc, amt, PORT_Sample),
+    PORT(WavetableOsc, position, PORT_Sample),
+};
+
+static const struct ModulePort noisePorts[] = {
+    PORT(Noise, amt, PORT_Sample),
+    PORT(Noise, color, PORT_Sample),
+    PORT_OPT(Noise, freqSample, PORT_Sample),
+    PORT_OPT(Noise, seed, PORT_Seed),
+};
+
+static const struct ModulePort unisonPorts[] = {
+    PORT(Unison, freqSample, PORT_Sample),
+    PORT(Unison, amt, PORT_Sample),
+    PORT(Unison, detune, PORT_Sample),
+    PORT(Unison, spread, PORT_Sample),
+    PORT(Unison, width, PORT_Sample),
+    PORT_MAX(Unison, voices, PORT_Size, UNISON_MAX_VOICES),
+};
+
+static const struct ModulePort delayPorts[] = {
+    PORT(Delay, sampleIn, PORT_Sample),
+    PORT(Delay, time, PORT_Sample),
+    PORT(Delay, feedback, PORT_Sample),
+    PORT(Delay, mix, PORT_Sample),
+    PORT_MAX(Delay, maxTimeMs, PORT_Size, DELAY_MAX_TIME_MS),
+};
+
+static const struct ModulePort reverbPorts[] = {
+    PORT(Reverb, sampleIn, PORT_Sample),
+    PORT(Reverb, roomSize, PORT_Float),
+    PORT(Reverb, decayMs, PORT_Float),
+    PORT(Reverb, damping, PORT_Sample),
+    PORT(Reverb, mix, PORT_Sample),
+    PORT_MAX(Reverb, lines, PORT_Size, REVERB_MAX_LINES),
+};
+
+static const struct ModuleInfo moduleInfos[MODULE_TYPE_COUNT] = {
+    [MODULE_Oscillator] = { "Oscillator", sizeof(struct Oscillator), oscillatorPorts, ARR_LEN(oscillatorPorts) },
+    [MODULE_EnvelopeAd] = { "EnvelopeAd", sizeof(struct EnvelopeAd), envelopeAdPorts, ARR_LEN(envelopeAdPorts) },
+    [MODULE_EnvelopeAr] = { "EnvelopeAr", sizeof(struct EnvelopeAr), envelopeArPorts, ARR_LEN(envelopeArPorts) },
+    [MODULE_EnvelopeAdr] = { "EnvelopeAdr", sizeof(struct EnvelopeAdr), envelopeAdrPorts, ARR_LEN(envelopeAdrPorts) },
+    [MODULE_EnvelopeAdsr] = { "EnvelopeAdsr", sizeof(struct EnvelopeAdsr), envelopeAdsrPorts, ARR_LEN(envelopeAdsrPorts) },
+    [MODULE_EnvelopeAdbdr] = { "EnvelopeAdbdr", sizeof(struct EnvelopeAdbdr), envelopeAdbdrPorts, ARR_LEN(envelopeAdbdrPorts) },
+    [MODULE_Amplifier] = { "Amplifier", sizeof(struct Amplifier), amplifierPorts, ARR_LEN(amplifierPorts) },
+    [MODULE_Distortion] = { "Distortion", sizeof(struct Distortion), distortionPorts, ARR_LEN(distortionPorts) },
+    [MODULE_Attenuator] = { "Attenuator", sizeof(struct Attenuator), attenuatorPorts, ARR_LEN(attenuatorPorts) },
+    [MODULE_Mixer] = { "Mixer", sizeof(struct Mixer), mixerPorts, ARR_LEN(mixerPorts) },
+    [MODULE_Filter] = { "Filter", sizeof(struct Filter), filterPorts, ARR_LEN(filterPorts) },
+    [MODULE_Sampler] = { "Sampler", sizeof(struct Sampler), samplerPorts, ARR_LEN(samplerPorts) },
+    [MODULE_WavetableOsc] = { "WavetableOsc", sizeof(struct WavetableOsc), wavetableOscPorts, ARR_LEN(wavetableOscPorts) },
+    [MODULE_Noise] = { "Noise", sizeof(struct Noise), noisePorts, ARR_LEN(noisePorts) },
+    [MODULE_Unison] = {
+        "Unison", sizeof(struct Unison), unisonPorts, ARR_LEN(unisonPorts),
+        true, offsetof(struct Unison, outLeft), offsetof(struct Unison, outRight)
+    },
+    [MODULE_Delay] = { "Delay", sizeof(struct Delay), delayPorts, ARR_LEN(delayPorts) },
+    [MODULE_Reverb] = {
+        "Reverb", sizeof(struct Reverb), reverbPorts, ARR_LEN(reverbPorts),
+        true, offsetof(struct Reverb, outLeft), offsetof(struct Reverb, outRight)
+    },
+};
+
+const struct ModuleInfo *synthModuleInfo(enum SynthModuleType tag) {
+    if ((unsigned) tag >= MODULE_TYPE_COUNT) return NULL;
+    return &moduleInfos[tag];
+}
+
+// rebuilds what a module derives from its parameters, once at synthInit and
+// then whenever its version moves
+static void moduleRefresh(struct SynthModule *module, const struct SynthRate *rate) {
+    switch (module->tag) {
+    case MODULE_EnvelopeAd: {
+        struct EnvelopeAd *env = module->ptr;
+        env->_priv.attackPeriod = msToFrames(*env->attackMs, rate);
+        env->_priv.decayPeriod = msToFrames(*env->decayMs, rate);
+        break;
+    }
+    case MODULE_EnvelopeAr: {
+        struct EnvelopeAr *env = module->ptr;
+        env->_priv.attackPeriod = msToFrames(*env->attackMs, rate);
+        env->_priv.releasePeriod = msToFrames(*env->releaseMs, rate);
+        break;
+    }
+    case MODULE_EnvelopeAdr: {
+        struct EnvelopeAdr *env = module->ptr;
+        env->_priv.attackPeriod = msToFrames(*env->attackMs, rate);
+        env->_priv.decayPeriod = msToFrames(*env->decayMs, rate);
+        env->_priv.releasePeriod = msToFrames(*env->releaseMs, rate);
+        break;
+    }
+    case MODULE_EnvelopeAdsr: {
+        struct EnvelopeAdsr *env = module->ptr;
+        env->_priv.attackPeriod = msToFrames(*env->attackMs, rate);
+        env->_priv.decayPeriod = msToFrames(*env->decayMs, rate);
+        env->_priv.releasePeriod = msToFrames(*env->releaseMs, rate);
+        break;
+    }
+    case MODULE_EnvelopeAdbdr: {
+        struct EnvelopeAdbdr *env = module->ptr;
+        env->_priv.attackPeriod = msToFrames(*env->attackMs, rate);
+        env->_priv.decay1Period = msToFrames(*env->decay1Ms, rate);
+        env->_priv.decay2Period = msToFrames(*env->decay2Ms, rate);
+        env->_priv.releasePeriod = msToFrames(*env->releaseMs, rate);
+        break;
+    }
+    case MODULE_Filter: {
+        struct Filter *filter = module->ptr;
+        createFirWindow(filter->_priv.windowBuf, filter->window, filter->impulseLen);
+        filterUpdateImpulse(filter, rate);
+        filter->_priv.prevCutoff = *filter->cutoff;
+        break;
+    }
+    case MODULE_Reverb:
+        reverbUpdateLines(module->ptr, rate);
+        break;
+    default:
+        break;
+    }
+}
+
+// rough per frame cost, in about the ns a desktop core spends, for deciding
+// whether a branch is worth handing to another thread
+static size_t moduleCost(const struct Synth *synth, const struct SynthModule *module) {
+    switch (module->tag) {
+    case MODULE_Filter: {
+        const struct Filter *filter = module->ptr;
+        // a cutoff driven by another module rebuilds the taps every frame
+        uintptr_t cutoff = (uintptr_t) filter->cutoff;
+        uintptr_t table = (uintptr_t) synth->modules;
+        bool isModulated = cutoff >= table && cutoff < table + synth->modulesLen * sizeof(struct SynthModule);
+        return filter->impulseLen * (isModulated ? 8 : 1);
+    }
+    case MODULE_Unison: {
+        const struct Unison *unison = module->ptr;
+        return 10 + 3 * unison->voices;
+    }
+    case MODULE_Reverb:
+        return 60;
+    case MODULE_Distortion:
+        return 40;
+    case MODULE_Oscillator:
+    case MODULE_Sampler:
+    case MODULE_WavetableOsc:
+    case MODULE_Delay:
+        return 15;
+    default:
+        return 5;
+    }
+}
+
+// a branch has to cost about this much per frame before handing it to
+// another thread beats waking one
+#define SCHED_MIN_TASK_COST 400
+#define SCHED_TAIL UINT8_MAX
+
+// how synthInit splits the modules, worked out before the layout so it can
+// allocate exactly what the schedule needs
+struct SchedulePlan {
+    // task per module, SCHED_TAIL for modules that run on the calling thread
+    uint8_t *taskOf;
+    // branch modules the tail reads
+    bool *isExport;
+    size_t tasksLen;
+    size_t exportsLen;
+};
+
+// the module whose table entry or body holds ptr, SIZE_MAX for host memory
+// and constants
+static size_t moduleOwning(const struct Synth *synth, const void *ptr, bool *isBody) {
+    uintptr_t addr = (uintptr_t) ptr;
+    uintptr_t table = (uintptr_t) synth->modules;
+    *isBody = false;
+    if (addr >= table && addr < table + synth->modulesLen * sizeof(struct SynthModule)) {
+        return (addr - table) / sizeof(struct SynthModule);
+    }
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        uintptr_t body = (uintptr_t) synth->modules[i].ptr;
+        if (addr >= body && addr < body + moduleInfos[synth->modules[i].tag].size) {
+            *isBody = true;
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// every value a module reads from, returns how many
+static size_t moduleInputs(const struct SynthModule *module, const void **inputs, size_t cap) {
+    const struct ModuleInfo *info = &moduleInfos[module->tag];
+    const char *body = module->ptr;
+    size_t len = 0;
+
+    for (size_t p = 0; p < info->portsLen; p++) {
+        const struct ModulePort *port = &info->ports[p];
+        if (port->kind == PORT_SampleList) {
+            int16_t *const *list = *(int16_t *const *const *) (body + port->offset);
+            for (size_t j = 0; list != NULL && list[j] != NULL && len < cap; j++) {
+                inputs[len++] = list[j];
+            }
+        } else if ((port->kind == PORT_Sample || port->kind == PORT_Float || port->kind == PORT_Gate) && len < cap) {
+            const void *ptr = *(const void *const *) (body + port->offset);
+            if (ptr != NULL) inputs[len++] = ptr;
+        }
+    }
+    return len;
+}
+
+static size_t groupFind(size_t *group, size_t i) {
+    while (group[i] != i) {
+        group[i] = group[group[i]];
+        i = group[i];
+    }
+    return i;
+}
+
+static void groupJoin(size_t *group, size_t a, size_t b) {
+    a = groupFind(group, a);
+    b = groupFind(group, b);
+    if (a != b) group[a < b ? b : a] = a < b ? a : b;
+}
+
+// a module reading another's out or fields
+struct PlanEdge {
+    size_t src;
+    size_t reader;
+    // reading a body's fields (stereo outs) or an out only written later in
+    // the frame (the previous frame's value) can't be cut between threads
+    bool isHard;
+};
+
+// every edge between two modules, counted only when edges is NULL
+static size_t planEdges(const struct Synth *synth, struct PlanEdge *edges) {
+    const void *inputs[4 * SYNTH_MAX_LIST_LEN];
+    size_t len = 0;
+    for (size_t r = 0; r < synth->modulesLen; r++) {
+        size_t inputsLen = moduleInputs(&synth->modules[r], inputs, ARR_LEN(inputs));
+        for (size_t k = 0; k < inputsLen; k++) {
+            bool isBody;
+            size_t src = moduleOwning(synth, inputs[k], &isBody);
+            if (src == SIZE_MAX || src == r) continue;
+            if (edges != NULL) edges[len] = (struct PlanEdge){ src, r, isBody || src > r };
+            len++;
+        }
+    }
+    return len;
+}
+
+static void planFree(struct SchedulePlan *plan) {
+    free(plan->taskOf);
+    free(plan->isExport);
+    *plan = (struct SchedulePlan){0};
+}
+
+// scratch for synthPlan, all indexed by module
+struct PlanScratch {
+    const struct Synth *synth;
+    struct PlanEdge *edges;
+    size_t edgesLen;
+    // modules that can't run apart, joined over hard edges
+    size_t *group;
+    // modules joined into branches, over every edge outside the tail
+    size_t *branch;
+    bool *isTail;
+    bool *wasTail;
+    size_t *cost;
+};
+
+// anything reading the tail has to run in it
+static void planCloseTail(struct PlanScratch *scratch) {
+    bool isChanged = true;
+    while (isChanged) {
+        isChanged = false;
+        for (size_t e = 0; e < scratch->edgesLen; e++) {
+            const struct PlanEdge *edge = &scratch->edges[e];
+            size_t reader = groupFind(scratch->group, edge->reader);
+            if (scratch->isTail[groupFind(scratch->group, edge->src)] && !scratch->isTail[reader]) {
+                scratch->isTail[reader] = true;
+                isChanged = true;
+            }
+        }
+    }
+}
+
+// joins what's outside the tail into branches and sums their costs at the
+// branch roots, returns how many are heavy enough to run apart
+static size_t planBranches(struct PlanScratch *scratch) {
+    size_t len = scratch->synth->modulesLen;
+    for (size_t i = 0; i < len; i++) {
+        scratch->branch[i] = groupFind(scratch->group, i);
+        scratch->cost[i] = 0;
+    }
+    for (size_t e = 0; e < scratch->edgesLen; e++) {
+        const struct PlanEdge *edge = &scratch->edges[e];
+        if (scratch->isTail[scratch->branch[edge->src]] || scratch->isTail[scratch->branch[edge->reader]]) continue;
+        groupJoin(scratch->branch, edge->src, edge->reader);
+    }
+
+    size_t heavy = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (scratch->isTail[groupFind(scratch->group, i)]) continue;
+        scratch->cost[groupFind(scratch->branch, i)] += moduleCost(scratch->synth, &scratch->synth->modules[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (scratch->branch[i] == i && !scratch->isTail[groupFind(scratch->group, i)] && scratch->cost[i] >= SCHED_MIN_TASK_COST) heavy++;
+    }
+    return heavy;
+}
+
+// a branch that meets the tail at a single group (a mixer, say) may split
+// into independent layers once that group joins the tail. keeps the first such
+// move that leaves more heavy branches, returns whether it found one
+static bool planSplitJoin(struct PlanScratch *scratch, size_t heavy) {
+    size_t len = scratch->synth->modulesLen;
+    for (size_t root = 0; root < len; root++) {
+        if (scratch->branch[root] != root || scratch->isTail[groupFind(scratch->group, root)]) continue;
+
+        size_t sink = SIZE_MAX;
+        bool isSingle = true;
+        for (size_t e = 0; e < scratch->edgesLen && isSingle; e++) {
+            const struct PlanEdge *edge = &scratch->edges[e];
+            if (groupFind(scratch->branch, edge->src) != root || !scratch->isTail[groupFind(scratch->group, edge->reader)]) continue;
+            size_t group = groupFind(scratch->group, edge->src);
+            if (sink != SIZE_MAX && sink != group) isSingle = false;
+            sink = group;
+        }
+        if (sink == SIZE_MAX || !isSingle) continue;
+
+        memcpy(scratch->wasTail, scratch->isTail, len * sizeof(bool));
+        scratch->isTail[sink] = true;
+        planCloseTail(scratch);
+        if (planBranches(scratch) > heavy) return true;
+        memcpy(scratch->isTail, scratch->wasTail, len * sizeof(bool));
+        planBranches(scratch);
+    }
+    return false;
+}
+
+// the outputs and whatever reads them form the tail, run on the calling
+// thread. the rest splits into branches that only read host values and
+// themselves and only feed the tail through outs it reads later in the frame,
+// with joins like a mixer moved into the tail where that frees more branches.
+// branches are packed into at most one task per thread, and the plan stays
+// serial unless at least two tasks are heavy enough to pay for the handoff
+static void planTasks(struct PlanScratch *scratch, struct SchedulePlan *plan) {
+    const struct Synth *synth = scratch->synth;
+    size_t len = synth->modulesLen;
+
+    planEdges(synth, scratch->edges);
+    for (size_t i = 0; i < len; i++) scratch->group[i] = i;
+    for (size_t e = 0; e < scratch->edgesLen; e++) {
+        if (scratch->edges[e].isHard) groupJoin(scratch->group, scratch->edges[e].src, scratch->edges[e].reader);
+    }
+
+    bool isBody;
+    size_t out = moduleOwning(synth, synth->outPtr, &isBody);
+    if (out != SIZE_MAX) scratch->isTail[groupFind(scratch->group, out)] = true;
+    out = synth->outPtrRight != NULL ? moduleOwning(synth, synth->outPtrRight, &isBody) : SIZE_MAX;
+    if (out != SIZE_MAX) scratch->isTail[groupFind(scratch->group, out)] = true;
+    planCloseTail(scratch);
+
+    size_t heavy = planBranches(scratch);
+    while (planSplitJoin(scratch, heavy)) heavy = planBranches(scratch);
+    if (heavy < 2) return;
+
+    size_t tasksLen = poolWorkers() + 1;
+    if (synth->maxThreads > 0 && (size_t) synth->maxThreads < tasksLen) tasksLen = synth->maxThreads;
+    if (tasksLen > SYNTH_MAX_TASKS) tasksLen = SYNTH_MAX_TASKS;
+    if (tasksLen < 2) return;
+
+    // heaviest branch first into the lightest task
+    size_t taskCost[SYNTH_MAX_TASKS] = {0};
+    for (size_t i = 0; i < len; i++) plan->taskOf[i] = SCHED_TAIL;
+    for (;;) {
+        size_t root = SIZE_MAX;
+        for (size_t i = 0; i < len; i++) {
+            if (scratch->branch[i] != i || scratch->isTail[groupFind(scratch->group, i)] || plan->taskOf[i] != SCHED_TAIL) continue;
+            if (root == SIZE_MAX || scratch->cost[i] > scratch->cost[root]) root = i;
+        }
+        if (root == SIZE_MAX) break;
+        size_t task = 0;
+        for (size_t t = 1; t < tasksLen; t++) {
+            if (taskCost[t] < taskCost[task]) task = t;
+        }
+        plan->taskOf[root] = task;
+        taskCost[task] += scratch->cost[root];
+    }
+
+    // the second heaviest task is the work that overlaps
+    size_t first = 0;
+    size_t second = 0;
+    for (size_t t = 0; t < tasksLen; t++) {
+        if (taskCost[t] > first) {
+            second = first;
+            first = taskCost[t];
+        } else if (taskCost[t] > second) {
+            second = taskCost[t];
+        }
+    }
+    if (second < SCHED_MIN_TASK_COST) return;
+
+    plan->tasksLen = tasksLen;
+    for (size_t i = 0; i < len; i++) {
+        bool isTail = scratch->isTail[groupFind(scratch->group, i)];
+        plan->taskOf[i] = isTail ? SCHED_TAIL : plan->taskOf[groupFind(scratch->branch, i)];
+    }
+    for (size_t e = 0; e < scratch->edgesLen; e++) {
+        const struct PlanEdge *edge = &scratch->edges[e];
+        if (plan->taskOf[edge->src] != SCHED_TAIL && plan->taskOf[edge->reader] == SCHED_TAIL) plan->isExport[edge->src] = true;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (plan->isExport[i]) plan->exportsLen++;
+    }
+}
+
+static int synthPlan(const struct Synth *synth, struct SchedulePlan *plan) {
+    *plan = (struct SchedulePlan){0};
+    size_t len = synth->modulesLen;
+    if (len < 2 || synth->maxThreads == 1) return 0;
+
+    struct PlanScratch scratch = { .synth = synth, .edgesLen = planEdges(synth, NULL) };
+    scratch.edges = malloc((scratch.edgesLen + 1) * sizeof(struct PlanEdge));
+    scratch.group = malloc(len * sizeof(size_t));
+    scratch.branch = malloc(len * sizeof(size_t));
+    scratch.isTail = calloc(len, sizeof(bool));
+    scratch.wasTail = calloc(len, sizeof(bool));
+    scratch.cost = calloc(len, sizeof(size_t));
+    plan->taskOf = malloc(len * sizeof(uint8_t));
+    plan->isExport = calloc(len, sizeof(bool));
+
+    int err = 0;
+    if (scratch.edges == NULL || scratch.group == NULL || scratch.branch == NULL || scratch.isTail == NULL
+        || scratch.wasTail == NULL || scratch.cost == NULL || plan->taskOf == NULL || plan->isExport == NULL) {
+        err = -1;
+    } else {
+        planTasks(&scratch, plan);
+    }
+
+    free(scratch.edges);
+    free(scratch.group);
+    free(scratch.branch);
+    free(scratch.isTail);
+    free(scratch.wasTail);
+    free(scratch.cost);
+    if (plan->tasksLen == 0) planFree(plan);
+    return err;
+}
+
+// writers bump written, the rendering thread rebuilds a module's derived
+// state when it's moved past seen. inputs that may be another module's out
+// (filter cutoff, wavetable and unison pitch, unison gains) can
+// change every sample without anyone bumping a version, so those modules
+// keep comparing against the prev* value they last derived from
+struct ModuleVersion {
+    atomic_uint written;
+    unsigned seen;
+};
+
+// bodies only need their members' alignment, packing them lets small
+// neighbouring modules share cache lines
+#define MODULE_ALIGN 16
+
+static size_t listLen(int16_t *const *list) {
+    size_t len = 0;
+    while (list[len] != NULL) len++;
+    return len + 1;
+}
+
+static size_t reverbLineLen(const struct SynthRate *rate) {
+    return delayLineLen(reverbLineMs[REVERB_MAX_LINES - 1] * REVERB_MAX_SIZE, rate);
+}
+
+// mirrors the allocations synthLayout makes, in the same order
+static size_t layoutSize(const struct SynthModule *modules, size_t modulesLen, const struct SynthRate *rate,
+                         const struct SchedulePlan *plan) {
+    size_t hot = modulesLen * sizeof(struct SynthModule);
+    size_t buffers = 0;
+    size_t cold = 0;
+
+    for (size_t i = 0; i < modulesLen; i++) {
+        hot = arenaAlignUp(hot, MODULE_ALIGN) + moduleInfos[modules[i].tag].size;
+    }
+    for (size_t i = 0; i < modulesLen; i++) {
+        const struct ModuleInfo *info = &moduleInfos[modules[i].tag];
+        const char *body = modules[i].ptr;
+        for (size_t p = 0; p < info->portsLen; p++) {
+            if (info->ports[p].kind != PORT_SampleList) continue;
+            int16_t **list = *(int16_t***) (body + info->ports[p].offset);
+            if (list == NULL) continue;
+            hot = arenaAlignUp(hot, _Alignof(int16_t*)) + listLen(list) * sizeof(int16_t*);
+        }
+
+        if (modules[i].tag == MODULE_Filter) {
+            const struct Filter *filter = modules[i].ptr;
+            buffers = arenaAlignUp(buffers, ARENA_ALIGN) + filter->impulseLen * (sizeof(float) + 2 * sizeof(int16_t));
+            cold = arenaAlignUp(cold, ARENA_ALIGN) + filter->impulseLen * sizeof(float);
+        } else if (modules[i].tag == MODULE_Delay) {
+            const struct Delay *delay = modules[i].ptr;
+            buffers = arenaAlignUp(buffers, ARENA_ALIGN) + delayLineLen(delay->maxTimeMs, rate) * sizeof(float);
+        } else if (modules[i].tag == MODULE_Reverb) {
+            const struct Reverb *reverb = modules[i].ptr;
+            buffers = arenaAlignUp(buffers, ARENA_ALIGN) + reverbLines(reverb) * reverbLineLen(rate) * sizeof(float);
+        }
+    }
+
+    hot = arenaAlignUp(hot, _Alignof(uint32_t)) + modulesLen * sizeof(uint32_t);
+    hot = arenaAlignUp(hot, _Alignof(struct ModuleVersion)) + modulesLen * sizeof(struct ModuleVersion);
+    if (plan->tasksLen > 0) {
+        size_t indices = modulesLen + (plan->tasksLen + 2) + plan->exportsLen + (plan->tasksLen + 2);
+        hot = arenaAlignUp(hot, _Alignof(uint32_t)) + indices * sizeof(uint32_t);
+        buffers = arenaAlignUp(buffers, ARENA_ALIGN) + plan->exportsLen * SYNTH_SCHED_CHUNK * sizeof(int16_t);
+    }
+    return arenaAlignUp(hot, ARENA_ALIGN) + arenaAlignUp(buffers, ARENA_ALIGN) + cold;
+}
+
+// maps a pointer into the old module table or an old body to its new home,
+// anything else (host inputs, constants) stays where it is
+static void *relocate(void *ptr, const struct SynthModule *oldModules, const struct SynthModule *modules, size_t modulesLen) {
+    uintptr_t addr = (uintptr_t) ptr;
+    uintptr_t table = (uintptr_t) oldModules;
+    if (addr >= table && addr < table + modulesLen * sizeof(struct SynthModule)) {
+        return (char*) modules + (addr - table);
+    }
+
+    for (size_t i = 0; i < modulesLen; i++) {
+        uintptr_t body = (uintptr_t) oldModules[i].ptr;
+        if (addr >= body && addr < body + moduleInfos[modules[i].tag].size) {
+            return (char*) modules[i].ptr + (addr - body);
+        }
+    }
+    return ptr;
+}
+
+// moves the module table, bodies and their lists into one 64 byte aligned
+// allocation in schedule order, then the per-sample buffers, then cold
+// tables, so a block's run walks memory front to back. modules built on
+// the stack or by the patch loader can be freed afterwards, except the
+// host inputs and constants their ports point at
+static int synthLayout(struct Synth *synth, const struct SchedulePlan *plan) {
+    const struct SynthRate *rate = &synth->_priv.rate;
+    struct SynthModule *oldModules = synth->modules;
+    size_t modulesLen = synth->modulesLen;
+
+    struct Arena state;
+    if (arenaInit(&state, layoutSize(oldModules, modulesLen, rate, plan)) != 0) return -1;
+
+    struct SynthModule *modules = arenaAlloc(&state, modulesLen * sizeof(struct SynthModule), ARENA_ALIGN);
+    for (size_t i = 0; i < modulesLen; i++) {
+        size_t size = moduleInfos[oldModules[i].tag].size;
+        modules[i] = oldModules[i];
+        modules[i].ptr = arenaAlloc(&state, size, MODULE_ALIGN);
+        memcpy(modules[i].ptr, oldModules[i].ptr, size);
+    }
+
+    for (size_t i = 0; i < modulesLen; i++) {
+        const struct ModuleInfo *info = &moduleInfos[modules[i].tag];
+        char *body = modules[i].ptr;
+        for (size_t p = 0; p < info->portsLen; p++) {
+            const struct ModulePort *port = &info->ports[p];
+            switch (port->kind) {
+            case PORT_Sample:
+            case PORT_Float:
+            case PORT_Gate:
+                *(void**) (body + port->offset) = relocate(*(void**) (body + port->offset), oldModules, modules, modulesLen);
+                break;
+            case PORT_SampleList: {
+                int16_t **list = *(int16_t***) (body + port->offset);
+                if (list == NULL) break;
+                size_t len = listLen(list);
+                int16_t **packed = arenaAlloc(&state, len * sizeof(int16_t*), _Alignof(int16_t*));
+                for (size_t j = 0; j + 1 < len; j++) {
+                    packed[j] = relocate(list[j], oldModules, modules, modulesLen);
+                }
+                *(int16_t***) (body + port->offset) = packed;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+    synth->_priv.runList = arenaAlloc(&state, modulesLen * sizeof(uint32_t), _Alignof(uint32_t));
+    synth->_priv.runListLen = 0;
+    synth->_priv.versions = arenaAlloc(&state, modulesLen * sizeof(struct ModuleVersion), _Alignof(struct ModuleVersion));
+    struct SynthSchedule *sched = &synth->_priv.sched;
+    *sched = (struct SynthSchedule){0};
+    if (plan->tasksLen > 0) {
+        sched->tasksLen = plan->tasksLen;
+        sched->order = arenaAlloc(&state, modulesLen * sizeof(uint32_t), _Alignof(uint32_t));
+        sched->taskStart = arenaAlloc(&state, (plan->tasksLen + 2) * sizeof(uint32_t), _Alignof(uint32_t));
+        sched->exports = arenaAlloc(&state, plan->exportsLen * sizeof(uint32_t), _Alignof(uint32_t));
+        sched->exportStart = arenaAlloc(&state, (plan->tasksLen + 2) * sizeof(uint32_t), _Alignof(uint32_t));
+
+        size_t ordered = 0;
+        size_t exported = 0;
+        for (size_t task = 0; task <= plan->tasksLen; task++) {
+            uint8_t id = task < plan->tasksLen ? task : SCHED_TAIL;
+            sched->taskStart[task] = ordered;
+            sched->exportStart[task] = exported;
+            for (size_t i = 0; i < modulesLen; i++) {
+                if (plan->taskOf[i] != id) continue;
+                sched->order[ordered++] = i;
+                if (plan->isExport[i]) sched->exports[exported++] = i;
+            }
+        }
+        sched->taskStart[plan->tasksLen + 1] = ordered;
+        sched->exportStart[plan->tasksLen + 1] = exported;
+    }
+    size_t hotEnd = state.used;
+
+    for (size_t i = 0; i < modulesLen; i++) {
+        if (modules[i].tag == MODULE_Filter) {
+            struct Filter *filter = modules[i].ptr;
+            filter->_priv.impulseResponse = arenaAlloc(&state, filter->impulseLen * sizeof(float), ARENA_ALIGN);
+            filter->_priv.samplesBuf = arenaAlloc(&state, 2 * filter->impulseLen * sizeof(int16_t), _Alignof(int16_t));
+            filter->_priv.samplesBufIdx = 0;
+            filter->_priv.lastIn = 0;
+            filter->_priv.quietLen = filter->impulseLen;
+        } else if (modules[i].tag == MODULE_Delay) {
+            struct Delay *delay = modules[i].ptr;
+            size_t len = delayLineLen(delay->maxTimeMs, rate);
+            delay->_priv.buf = arenaAlloc(&state, len * sizeof(float), ARENA_ALIGN);
+            delay->_priv.mask = len - 1;
+            delay->_priv.writeIdx = 0;
+            delay->_priv.delayFrames = sampleToFloat(*delay->time, 0, delay->maxTimeMs) * rate->framesPerMs;
+        } else if (modules[i].tag == MODULE_Reverb) {
+            struct Reverb *reverb = modules[i].ptr;
+            size_t len = reverbLineLen(rate);
+            reverb->_priv.buf = arenaAlloc(&state, reverbLines(reverb) * len * sizeof(float), ARENA_ALIGN);
+            reverb->_priv.mask = len - 1;
+            reverb->_priv.writeIdx = 0;
+        }
+    }
+    if (plan->tasksLen > 0) {
+        sched->captures = arenaAlloc(&state, plan->exportsLen * SYNTH_SCHED_CHUNK * sizeof(int16_t), ARENA_ALIGN);
+    }
+    size_t buffersEnd = state.used;
+
+    for (size_t i = 0; i < modulesLen; i++) {
+        if (modules[i].tag != MODULE_Filter) continue;
+        struct Filter *filter = modules[i].ptr;
+        filter->_priv.windowBuf = arenaAlloc(&state, filter->impulseLen * sizeof(float), ARENA_ALIGN);
+    }
+
+    synth->outPtr = relocate(synth->outPtr, oldModules, modules, modulesLen);
+    if (synth->outPtrRight != NULL) {
+        synth->outPtrRight = relocate(synth->outPtrRight, oldModules, modules, modulesLen);
+    }
+
+    // the old state may hold the table we just copied from, so it goes last
+    arenaFree(&synth->_priv.state);
+    synth->_priv.state = state;
+    synth->_priv.footprint = (struct SynthFootprint){
+        .hot = hotEnd,
+        .buffers = buffersEnd - hotEnd,
+        .cold = state.used - buffersEnd,
+    };
+    synth->modules = modules;
+    return 0;
+}
+
+static int synthError(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "synth: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    return -1;
+}
+
+// constants set through synthAddModule live in the arena next to their module
+union SynthConst {
+    int16_t sample;
+    float f;
+    bool gate;
+};
+
+static bool isPointerPort(enum PortKind kind) {
+    return kind == PORT_Sample || kind == PORT_Float || kind == PORT_Gate
+        || kind == PORT_SampleData || kind == PORT_Wavetable;
+}
+
+// worst case arena use of one module: its body, a constant per port and a
+// full list per SampleList port, each with room for alignment
+static size_t moduleBudget(const struct ModuleInfo *info) {
+    size_t size = info->size + MODULE_ALIGN;
+    for (size_t p = 0; p < info->portsLen; p++) {
+        if (info->ports[p].kind == PORT_SampleList) {
+            size += (SYNTH_MAX_LIST_LEN + 1) * sizeof(int16_t*) + _Alignof(int16_t*);
+        } else if (isPointerPort(info->ports[p].kind)) {
+            size += sizeof(union SynthConst) + _Alignof(union SynthConst);
+        }
+    }
+    return size;
+}
+
+static const struct ModulePort *findPort(const struct ModuleInfo *info, const char *name) {
+    for (size_t p = 0; p < info->portsLen; p++) {
+        if (strcmp(info->ports[p].name, name) == 0) return &info->ports[p];
+    }
+    return NULL;
+}
+
+static int listAppend(struct Arena *arena, const struct ModuleInfo *info, const struct ModulePort *port,
+                      char *body, int16_t *src) {
+    int16_t ***list = (int16_t***) (body + port->offset);
+    if (*list == NULL) {
+        *list = arenaAlloc(arena, (SYNTH_MAX_LIST_LEN + 1) * sizeof(int16_t*), _Alignof(int16_t*));
+        if (*list == NULL) return synthError("out of memory");
+    }
+
+    size_t len = 0;
+    while ((*list)[len] != NULL) len++;
+    if (len == SYNTH_MAX_LIST_LEN) return synthError("%s.%s is full", info->name, port->name);
+    (*list)[len] = src;
+    return 0;
+}
+
+static int bindParam(struct Arena *arena, const struct ModuleInfo *info, const struct ModulePort *port,
+                     char *body, const struct SynthParam *param) {
+    if (param->hostPtr != NULL) {
+        if (port->kind == PORT_SampleList) return listAppend(arena, info, port, body, param->hostPtr);
+        if (!isPointerPort(port->kind)) return synthError("%s.%s takes a value", info->name, port->name);
+        *(void**) (body + port->offset) = param->hostPtr;
+        return 0;
+    }
+
+    double value = param->value;
+    switch (port->kind) {
+    case PORT_Size:
+        if (!(value >= 1 && value <= port->maxValue)) return synthError("%s.%s out of range", info->name, port->name);
+        *(size_t*) (body + port->offset) = value;
+        return 0;
+    case PORT_Window:
+        if (!(value >= 0 && value <= WINDOW_Blackman)) return synthError("%s.%s unknown window", info->name, port->name);
+        *(enum FirWindowType*) (body + port->offset) = value;
+        return 0;
+    case PORT_Seed:
+        if (!(value >= 0 && value <= UINT32_MAX)) return synthError("%s.%s out of range", info->name, port->name);
+        *(uint32_t*) (body + port->offset) = value;
+        return 0;
+    case PORT_Sample:
+    case PORT_Float:
+    case PORT_Gate:
+        break;
+    default:
+        return synthError("%s.%s only takes references", info->name, port->name);
+    }
+
+    if (port->kind == PORT_Sample && !(value >= INT16_MIN && value <= INT16_MAX))
+        return synthError("%s.%s out of range", info->name, port->name);
+    if (port->kind == PORT_Float && !isfinite(value)) return synthError("%s.%s not finite", info->name, port->name);
+
+    union SynthConst *slot = arenaAlloc(arena, sizeof(*slot), _Alignof(union SynthConst));
+    if (slot == NULL) return synthError("out of memory");
+    if (port->kind == PORT_Sample) slot->sample = value;
+    else if (port->kind == PORT_Gate) slot->gate = value != 0;
+    else slot->f = value;
+    *(void**) (body + port->offset) = slot;
+    return 0;
+}
+
+int synthCreate(struct Synth *synth, size_t maxModules) {
+    size_t budget = 0;
+    for (size_t tag = 0; tag < MODULE_TYPE_COUNT; tag++) {
+        size_t moduleSize = moduleBudget(&moduleInfos[tag]);
+        if (moduleSize > budget) budget = moduleSize;
+    }
+
+    *synth = (struct Synth){0};
+    size_t size = maxModules * sizeof(struct SynthModule) + maxModules * budget;
+    if (arenaInit(&synth->arena, size) != 0) return synthError("out of memory");
+    synth->modules = arenaAlloc(&synth->arena, maxModules * sizeof(struct SynthModule), ARENA_ALIGN);
+    synth->_priv.modulesCap = maxModules;
+    return 0;
+}
+
+int synthAddModule(struct Synth *synth, enum SynthModuleType tag, const struct SynthParam *params, size_t paramsLen) {
+    const struct ModuleInfo *info = synthModuleInfo(tag);
+    if (info == NULL) return synthError("unknown module type %d", tag);
+    if (synth->_priv.isInit) return synthError("%s added after synthInit", info->name);
+    if (synth->modulesLen == synth->_priv.modulesCap) return synthError("no room for %s", info->name);
+
+    // a bad param leaves the arena as it was
+    size_t mark = synth->arena.used;
+    char *body = arenaAlloc(&synth->arena, info->size, MODULE_ALIGN);
+    if (body == NULL) return synthError("out of memory");
+
+    for (size_t i = 0; i < paramsLen; i++) {
+        const struct ModulePort *port = findPort(info, params[i].port);
+        if (port == NULL || bindParam(&synth->arena, info, port, body, &params[i]) != 0) {
+            arenaRewind(&synth->arena, mark);
+            return port == NULL ? synthError("%s has no port %s", info->name, params[i].port) : -1;
+        }
+    }
+
+    synth->modules[synth->modulesLen] = (struct SynthModule){ .ptr = body, .tag = tag };
+    return synth->modulesLen++;
+}
+
+int synthConnect(struct Synth *synth, int src, int dst, const char *portName) {
+    if (synth->_priv.isInit) return synthError("connection made after synthInit");
+    if (src < 0 || (size_t) src >= synth->modulesLen) return synthError("no module %d", src);
+    if (dst < 0 || (size_t) dst >= synth->modulesLen) return synthError("no module %d", dst);
+
+    const struct ModuleInfo *info = &moduleInfos[synth->modules[dst].tag];
+    const struct ModulePort *port = findPort(info, portName);
+    if (port == NULL) return synthError("%s has no port %s", info->name, portName);
+
+    char *body = synth->modules[dst].ptr;
+    int16_t *out = &synth->modules[src].out;
+    if (port->kind == PORT_SampleList) return listAppend(&synth->arena, info, port, body, out);
+    if (port->kind != PORT_Sample) return synthError("%s.%s can't take a module output", info->name, port->name);
+
+    *(int16_t**) (body + port->offset) = out;
+    return 0;
+}
+
+int synthSetOut(struct Synth *synth, int module) {
+    if (synth->_priv.isInit) return synthError("output changed after synthInit");
+    if (module < 0 || (size_t) module >= synth->modulesLen) return synthError("no module %d", module);
+
+    const struct ModuleInfo *info = &moduleInfos[synth->modules[module].tag];
+    if (info->isStereo) {
+        char *body = synth->modules[module].ptr;
+        synth->outPtr = (int16_t*) (body + info->outLeftOffset);
+        synth->outPtrRight = (int16_t*) (body + info->outRightOffset);
+    } else {
+        synth->outPtr = &synth->modules[module].out;
+        synth->outPtrRight = NULL;
+    }
+    return 0;
+}
+
+int synthSetParam(struct Synth *synth, int module, const char *portName, double value) {
+    if (module < 0 || (size_t) module >= synth->modulesLen) return synthError("no module %d", module);
+
+    const struct ModuleInfo *info = &moduleInfos[synth->modules[module].tag];
+    const struct ModulePort *port = findPort(info, portName);
+    if (port == NULL) return synthError("%s has no port %s", info->name, portName);
+
+    char *body = synth->modules[module].ptr;
+    void *target = *(void**) (body + port->offset);
+    if (isPointerPort(port->kind)) {
+        uintptr_t addr = (uintptr_t) target;
+        uintptr_t table = (uintptr_t) synth->modules;
+        if (target == NULL) return synthError("%s.%s not connected", info->name, port->name);
+        if (addr >= table && addr < table + synth->modulesLen * sizeof(struct SynthModule))
+            return synthError("%s.%s follows a module", info->name, port->name);
+    }
+
+    switch (port->kind) {
+    case PORT_Sample:
+        if (!(value >= INT16_MIN && value <= INT16_MAX)) return synthError("%s.%s out of range", info->name, port->name);
+        *(int16_t*) target = value;
+        break;
+    case PORT_Float:
+        if (!isfinite(value)) return synthError("%s.%s not finite", info->name, port->name);
+        *(float*) target = value;
+        break;
+    case PORT_Gate:
+        *(bool*) target = value != 0;
+        break;
+    case PORT_Window:
+        if (!(value >= 0 && value <= WINDOW_Blackman)) return synthError("%s.%s unknown window", info->name, port->name);
+        *(enum FirWindowType*) (body + port->offset) = value;
+        break;
+    default:
+        return synthError("%s.%s can't change once built", info->name, port->name);
+    }
+
+    synthTouch(synth, module);
+    return 0;
 }
 
-void synthInit(struct Synth *synth) {
+void synthTouch(struct Synth *synth, int module) {
+    // before synthInit there's nothing derived yet, it builds everything
+    if (synth->_priv.versions == NULL || module < 0 || (size_t) module >= synth->modulesLen) return;
+    atomic_fetch_add_explicit(&synth->_priv.versions[module].written, 1, memory_order_release);
+}
+
+// every module has to have its required ports bound before it first runs
+static int synthValidate(const struct Synth *synth) {
+    if (synth->outPtr == NULL) return synthError("no output set");
+
     for (size_t i = 0; i < synth->modulesLen; i++) {
-        if (synth->modules[i].tag == MODULE_Filter) {
-            struct Filter *filter = synth->modules[i].ptr;
-            createFirWindow(filter->_priv.windowBuf, filter->window, filter->impulseLen);
+        const struct ModuleInfo *info = synthModuleInfo(synth->modules[i].tag);
+        if (info == NULL) return synthError("module %zu has unknown type", i);
+
+        const char *body = synth->modules[i].ptr;
+        for (size_t p = 0; p < info->portsLen; p++) {
+            const struct ModulePort *port = &info->ports[p];
+            if (port->isOptional) continue;
+
+            bool isBound = true;
+            if (port->kind == PORT_Size) isBound = *(const size_t*) (body + port->offset) != 0;
+            else if (port->kind != PORT_Window && port->kind != PORT_Seed) isBound = *(void *const *) (body + port->offset) != NULL;
+            if (!isBound) return synthError("%s.%s not connected", info->name, port->name);
+        }
+    }
+    return 0;
+}
+
+struct SynthFootprint synthFootprint(const struct Synth *synth) {
+    return synth->_priv.footprint;
+}
+
+void synthDestroy(struct Synth *synth) {
+    for (size_t i = 0; synth->_priv.isInit && i < synth->modulesLen; i++) {
+        if (synth->modules[i].tag == MODULE_Sampler) {
+            struct Sampler *sampler = synth->modules[i].ptr;
+            samplePlayerRelease(sampler->sample, sampler->_priv.player);
+        }
+    }
+    arenaFree(&synth->arena);
+    arenaFree(&synth->_priv.state);
+    synth->modules = NULL;
+    synth->modulesLen = 0;
+    synth->_priv.modulesCap = 0;
+    synth->_priv.footprint = (struct SynthFootprint){0};
+    synth->_priv.sched = (struct SynthSchedule){0};
+    synth->_priv.isInit = false;
+}
+
+int synthInit(struct Synth *synth) {
+    if (synth->sampleRate <= 0) {
+        synth->sampleRate = DEFAULT_SAMPLE_RATE;
+    }
+
+    dspInit();
+
+    struct SynthRate *rate = &synth->_priv.rate;
+    rate->sampleRate = synth->sampleRate;
+    rate->framesPerMs = synth->sampleRate / 1000.0f;
+    rate->radPerFrame = M_TAU / synth->sampleRate;
+
+    if (synthValidate(synth) != 0) return -1;
+    struct SchedulePlan plan;
+    if (synthPlan(synth, &plan) != 0) return synthError("out of memory");
+    int err = synthLayout(synth, &plan);
+    planFree(&plan);
+    if (err != 0) return synthError("out of memory");
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        moduleRefresh(&synth->modules[i], rate);
+    }
+
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        if (synth->modules[i].tag == MODULE_Oscillator) {
+            struct Oscillator *osc = synth->modules[i].ptr;
+            noiseSeed(&osc->_priv.noise, moduleSeed(i));
+        }
+        if (synth->modules[i].tag == MODULE_Noise) {
+            struct Noise *noise = synth->modules[i].ptr;
+            noiseSeed(&noise->_priv.gen, noise->seed != 0 ? noise->seed : moduleSeed(i));
+        }
+        if (synth->modules[i].tag == MODULE_Sampler) {
+            struct Sampler *sampler = synth->modules[i].ptr;
+            sampler->_priv.player = samplePlayerClaim(sampler->sample);
+        }
+    }
+
+    synth->_priv.isInit = true;
+    return 0;
+}
+
+static void runModule(struct Synth *synth, size_t i) {
+    const struct SynthRate *rate = &synth->_priv.rate;
+    void *ptr = synth->modules[i].ptr;
+    switch (synth->modules[i].tag) {
+    case MODULE_Oscillator:
+        synth->modules[i].out = oscRun(ptr, rate);
+        break;
+    case MODULE_EnvelopeAd:
+        synth->modules[i].out = envAdRun(ptr);
+        break;
+    case MODULE_EnvelopeAr:
+        synth->modules[i].out = envArRun(ptr);
+        break;
+    case MODULE_EnvelopeAdr:
+        synth->modules[i].out = envAdrRun(ptr);
+        break;
+    case MODULE_EnvelopeAdsr:
+        synth->modules[i].out = envAdsrRun(ptr);
+        break;
+    case MODULE_EnvelopeAdbdr:
+        synth->modules[i].out = envAdbdrRun(ptr);
+        break;
+    case MODULE_Amplifier:
+        synth->modules[i].out = ampRun(ptr);
+        break;
+    case MODULE_Distortion:
+        synth->modules[i].out = distRun(ptr);
+        break;
+    case MODULE_Attenuator:
+        synth->modules[i].out = attrRun(ptr);
+        break;
+    case MODULE_Mixer:
+        synth->modules[i].out = mixerRun(ptr);
+        break;
+    case MODULE_Filter:
+        synth->modules[i].out = filterRun(ptr, rate);
+        break;
+    case MODULE_Sampler:
+        synth->modules[i].out = samplerRun(ptr, rate);
+        break;
+    case MODULE_WavetableOsc:
+        synth->modules[i].out = wavetableRun(ptr, rate);
+        break;
+    case MODULE_Noise:
+        synth->modules[i].out = noiseRun(ptr, rate);
+        break;
+    case MODULE_Unison:
+        synth->modules[i].out = unisonRun(ptr, rate);
+        break;
+    case MODULE_Delay:
+        synth->modules[i].out = delayRun(ptr, rate);
+        break;
+    case MODULE_Reverb:
+        synth->modules[i].out = reverbRun(ptr);
+        break;
+    default:
+        break;
+    }
+}
+
+// picks up parameters written since the last call
+static void synthRefresh(struct Synth *synth) {
+    struct ModuleVersion *versions = synth->_priv.versions;
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        unsigned written = atomic_load_explicit(&versions[i].written, memory_order_acquire);
+        synth->modules[i]._priv.isRefreshed = written != versions[i].seen;
+        if (synth->modules[i]._priv.isRefreshed) {
+            moduleRefresh(&synth->modules[i], &synth->_priv.rate);
+            versions[i].seen = written;
         }
     }
 }
 
 void synthRun(struct Synth *synth) {
-    if (synth->_priv.isInit == false) {
-        synthInit(synth);
-        synth->_priv.isInit = true;
+    if (synth->_priv.isInit == false && synthInit(synth) != 0) {
+        return;
     }
+    synthRefresh(synth);
     for (size_t i = 0; i < synth->modulesLen; i++) {
-        void *ptr = synth->modules[i].ptr;
-        switch (synth->modules[i].tag) {
-        case MODULE_Oscillator:
-            synth->modules[i].out = oscRun(ptr);
-            break;
-        case MODULE_EnvelopeAd:
-            synth->modules[i].out = envAdRun(ptr);
-            break;
-        case MODULE_EnvelopeAr:
-            synth->modules[i].out = envArRun(ptr);
-            break;
-        case MODULE_EnvelopeAdr:
-            synth->modules[i].out = envAdrRun(ptr);
-            break;
-        case MODULE_EnvelopeAdsr:
-            synth->modules[i].out = envAdsrRun(ptr);
-            break;
-        case MODULE_EnvelopeAdbdr:
-            synth->modules[i].out = envAdbdrRun(ptr);
-            break;
-        case MODULE_Amplifier:
-            synth->modules[i].out = ampRun(ptr);
-            break;
-        case MODULE_Distortion:
-            synth->modules[i].out = distRun(ptr);
-            break;
-        case MODULE_Attenuator:
-            synth->modules[i].out = attrRun(ptr);
-            break;
-        case MODULE_Mixer:
-            synth->modules[i].out = mixerRun(ptr);
-            break;
-        case MODULE_Filter:
-            synth->modules[i].out = filterRun(ptr);
-            break;
+        runModule(synth, i);
+    }
+}
+
+// decided per module when a block starts, from its own state and how still
+// its inputs are
+enum ModuleActivity {
+    // runs on every frame
+    ACTIVITY_Active,
+    // inputs hold still for the block, runs on the first frame only
+    ACTIVITY_Const,
+    // out already holds the block's value, doesn't run at all
+    ACTIVITY_Idle,
+};
+
+// how still an input of module reader is this block. host inputs and
+// constants only change between blocks. an earlier module's out is read
+// after it ran, so one computed on the first frame holds for the block,
+// a later one is read a frame behind and only holds if it doesn't run
+static enum ModuleActivity inputActivity(const struct Synth *synth, size_t reader, const void *ptr) {
+    uintptr_t addr = (uintptr_t) ptr;
+    uintptr_t table = (uintptr_t) synth->modules;
+    if (addr < table || addr >= table + synth->modulesLen * sizeof(struct SynthModule)) return ACTIVITY_Idle;
+
+    size_t src = (addr - table) / sizeof(struct SynthModule);
+    enum ModuleActivity activity = synth->modules[src]._priv.activity;
+    if (activity == ACTIVITY_Const && src >= reader) return ACTIVITY_Active;
+    return activity;
+}
+
+// the least still of a module's inputs
+static enum ModuleActivity inputsActivity(const struct Synth *synth, size_t i) {
+    const struct ModuleInfo *info = &moduleInfos[synth->modules[i].tag];
+    const char *body = synth->modules[i].ptr;
+    enum ModuleActivity activity = ACTIVITY_Idle;
+
+    for (size_t p = 0; p < info->portsLen && activity != ACTIVITY_Active; p++) {
+        const struct ModulePort *port = &info->ports[p];
+        if (port->kind == PORT_SampleList) {
+            int16_t *const *list = *(int16_t *const *const *) (body + port->offset);
+            for (size_t j = 0; list != NULL && list[j] != NULL; j++) {
+                enum ModuleActivity input = inputActivity(synth, i, list[j]);
+                if (input < activity) activity = input;
+            }
+        } else if (port->kind == PORT_Sample || port->kind == PORT_Float || port->kind == PORT_Gate) {
+            const void *ptr = *(const void *const *) (body + port->offset);
+            if (ptr == NULL) continue;
+            enum ModuleActivity input = inputActivity(synth, i, ptr);
+            if (input < activity) activity = input;
         }
     }
+    return activity;
+}
+
+// the stage and gate of an envelope module, false for anything else
+static bool envelopeState(const struct SynthModule *module, enum EnvelopeStage *stage, bool *gate) {
+    switch (module->tag) {
+    case MODULE_EnvelopeAd: {
+        const struct EnvelopeAd *env = module->ptr;
+        *stage = env->_priv.stage;
+        *gate = *env->gate;
+        return true;
+    }
+    case MODULE_EnvelopeAr: {
+        const struct EnvelopeAr *env = module->ptr;
+        *stage = env->_priv.stage;
+        *gate = *env->gate;
+        return true;
+    }
+    case MODULE_EnvelopeAdr: {
+        const struct EnvelopeAdr *env = module->ptr;
+        *stage = env->_priv.stage;
+        *gate = *env->gate;
+        return true;
+    }
+    case MODULE_EnvelopeAdsr: {
+        const struct EnvelopeAdsr *env = module->ptr;
+        *stage = env->_priv.stage;
+        *gate = *env->gate;
+        return true;
+    }
+    case MODULE_EnvelopeAdbdr: {
+        const struct EnvelopeAdbdr *env = module->ptr;
+        *stage = env->_priv.stage;
+        *gate = *env->gate;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// a pending envelope waits for the gate, a finished one for its release,
+// both hold INT16_MIN until then
+static bool envelopeIsIdle(const struct SynthModule *module) {
+    enum EnvelopeStage stage;
+    bool gate;
+    if (!envelopeState(module, &stage, &gate)) return false;
+    return module->out == INT16_MIN && ((stage == STAGE_Pending && !gate) || (stage == STAGE_Finished && gate));
+}
+
+bool synthIsReleased(const struct Synth *synth) {
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        enum EnvelopeStage stage;
+        bool gate;
+        if (!envelopeState(&synth->modules[i], &stage, &gate)) continue;
+        if (stage != STAGE_Finished && stage != STAGE_Pending) return false;
+    }
+    return true;
+}
+
+size_t synthLongestLine(const struct Synth *synth) {
+    size_t longest = 0;
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        size_t len = 0;
+        if (synth->modules[i].tag == MODULE_Delay) {
+            const struct Delay *delay = synth->modules[i].ptr;
+            len = delay->_priv.mask + 1;
+        } else if (synth->modules[i].tag == MODULE_Reverb) {
+            const struct Reverb *reverb = synth->modules[i].ptr;
+            len = reverb->_priv.mask + 1;
+        }
+        if (len > longest) longest = len;
+    }
+    return longest;
+}
+
+static enum ModuleActivity moduleActivity(const struct Synth *synth, size_t i) {
+    const struct SynthModule *module = &synth->modules[i];
+    // derived state was just rebuilt, so its out may move even if nothing else does
+    if (module->_priv.isRefreshed) return ACTIVITY_Active;
+    enum ModuleActivity inputs = inputsActivity(synth, i);
+
+    switch (module->tag) {
+    case MODULE_Oscillator: {
+        // silent, only its clock moves and synthBlockEnd catches that up
+        const struct Oscillator *osc = module->ptr;
+        bool isSilent = *osc->waveform != WAV_Noise && *osc->amt == INT16_MIN && module->out == 0;
+        return inputs == ACTIVITY_Idle && isSilent ? ACTIVITY_Idle : ACTIVITY_Active;
+    }
+    case MODULE_EnvelopeAd:
+    case MODULE_EnvelopeAr:
+    case MODULE_EnvelopeAdr:
+    case MODULE_EnvelopeAdsr:
+    case MODULE_EnvelopeAdbdr:
+        return inputs == ACTIVITY_Idle && envelopeIsIdle(module) ? ACTIVITY_Idle : ACTIVITY_Active;
+    case MODULE_Filter: {
+        // the tail has to play out first, then the same history gives the same out
+        const struct Filter *filter = module->ptr;
+        bool isSettled = *filter->sampleIn == filter->_priv.lastIn
+            && filter->_priv.quietLen >= filter->impulseLen
+            && *filter->cutoff == filter->_priv.prevCutoff;
+        return inputs == ACTIVITY_Idle && isSettled ? ACTIVITY_Idle : ACTIVITY_Active;
+    }
+    case MODULE_Amplifier:
+    case MODULE_Distortion:
+    case MODULE_Attenuator:
+    case MODULE_Mixer: {
+        // no state, so settled inputs give the block's out right away
+        if (inputs != ACTIVITY_Idle) return inputs;
+        int16_t out;
+        if (module->tag == MODULE_Amplifier) out = ampRun(module->ptr);
+        else if (module->tag == MODULE_Distortion) out = distRun(module->ptr);
+        else if (module->tag == MODULE_Attenuator) out = attrRun(module->ptr);
+        else out = mixerRun(module->ptr);
+        return out == module->out ? ACTIVITY_Idle : ACTIVITY_Const;
+    }
+    default:
+        return ACTIVITY_Active;
+    }
+}
+
+// advances an idle oscillator's clock as frames calls to oscRun would
+static void oscSkip(struct Oscillator *osc, const struct SynthRate *rate, size_t frames) {
+    float period = rate->sampleRate / sampleToFreq(*osc->freqSample);
+    // t runs through 0..period, or wraps at the top of its range first
+    uint32_t cycle = period >= UINT16_MAX ? UINT16_MAX + 1 : (uint32_t) period + 1;
+    uint32_t t = osc->_priv.t > period ? 0 : osc->_priv.t;
+    osc->_priv.t = (t + (frames - 1) % cycle) % cycle + 1;
+}
+
+// modules start the block optimistic and are marked down until nothing
+// changes, so a later module feeding an earlier one settles too
+static int synthBlockBegin(struct Synth *synth) {
+    if (synth->_priv.isInit == false && synthInit(synth) != 0) {
+        return -1;
+    }
+    synthRefresh(synth);
+
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        synth->modules[i]._priv.activity = ACTIVITY_Idle;
+    }
+    bool isChanged = true;
+    while (isChanged) {
+        isChanged = false;
+        for (size_t i = 0; i < synth->modulesLen; i++) {
+            enum ModuleActivity activity = moduleActivity(synth, i);
+            if (activity != synth->modules[i]._priv.activity) {
+                synth->modules[i]._priv.activity = activity;
+                isChanged = true;
+            }
+        }
+    }
+
+    synth->_priv.runListLen = 0;
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        if (synth->modules[i]._priv.activity == ACTIVITY_Active) {
+            synth->_priv.runList[synth->_priv.runListLen++] = i;
+        }
+    }
+    return 0;
+}
+
+bool synthModuleIsActive(const struct Synth *synth, int module) {
+    if (module < 0 || (size_t) module >= synth->modulesLen) return false;
+    return synth->modules[module]._priv.activity == ACTIVITY_Active;
+}
+
+// the first frame also runs modules that only settle to a new constant
+static bool moduleIsDue(const struct SynthModule *module, size_t frame) {
+    return module->_priv.activity == ACTIVITY_Active || (frame == 0 && module->_priv.activity != ACTIVITY_Idle);
+}
+
+struct SchedChunk {
+    struct Synth *synth;
+    size_t start;
+    size_t len;
+};
+
+// one task's branches over the chunk, keeping the outs the tail reads
+static void schedRunTask(void *ctx, size_t task) {
+    const struct SchedChunk *chunk = ctx;
+    struct Synth *synth = chunk->synth;
+    const struct SynthSchedule *sched = &synth->_priv.sched;
+    // workers render for the audio callback, so they're held to the same rules
+    rtEnter();
+
+    for (size_t f = 0; f < chunk->len; f++) {
+        for (size_t k = sched->taskStart[task]; k < sched->taskStart[task + 1]; k++) {
+            if (moduleIsDue(&synth->modules[sched->order[k]], chunk->start + f)) runModule(synth, sched->order[k]);
+        }
+        for (size_t e = sched->exportStart[task]; e < sched->exportStart[task + 1]; e++) {
+            sched->captures[e * SYNTH_SCHED_CHUNK + f] = synth->modules[sched->exports[e]].out;
+        }
+    }
+    rtLeave();
+}
+
+// branches render ahead a chunk at a time, then the tail reads their outs
+// back frame by frame exactly as it would have seen them serially
+static void synthScheduledFrame(struct Synth *synth, size_t frame, size_t frames) {
+    const struct SynthSchedule *sched = &synth->_priv.sched;
+    size_t f = frame % SYNTH_SCHED_CHUNK;
+    if (f == 0) {
+        struct SchedChunk chunk = {
+            .synth = synth,
+            .start = frame,
+            .len = frames - frame < SYNTH_SCHED_CHUNK ? frames - frame : SYNTH_SCHED_CHUNK,
+        };
+        poolRun(sched->tasksLen, schedRunTask, &chunk);
+    }
+
+    for (size_t e = 0; e < sched->exportStart[sched->tasksLen]; e++) {
+        synth->modules[sched->exports[e]].out = sched->captures[e * SYNTH_SCHED_CHUNK + f];
+    }
+    for (size_t k = sched->taskStart[sched->tasksLen]; k < sched->taskStart[sched->tasksLen + 1]; k++) {
+        if (moduleIsDue(&synth->modules[sched->order[k]], frame)) runModule(synth, sched->order[k]);
+    }
+}
+
+static void synthBlockFrame(struct Synth *synth, size_t frame, size_t frames) {
+    if (synth->_priv.sched.tasksLen > 0) {
+        synthScheduledFrame(synth, frame, frames);
+        return;
+    }
+    if (frame == 0) {
+        for (size_t i = 0; i < synth->modulesLen; i++) {
+            if (synth->modules[i]._priv.activity != ACTIVITY_Idle) runModule(synth, i);
+        }
+        return;
+    }
+    for (size_t k = 0; k < synth->_priv.runListLen; k++) {
+        runModule(synth, synth->_priv.runList[k]);
+    }
+}
+
+static void synthBlockEnd(struct Synth *synth, size_t frames) {
+    for (size_t i = 0; i < synth->modulesLen; i++) {
+        if (synth->modules[i].tag == MODULE_Oscillator && synth->modules[i]._priv.activity == ACTIVITY_Idle) {
+            oscSkip(synth->modules[i].ptr, &synth->_priv.rate, frames);
+        }
+        // once a block is plenty for a prefetcher reading SAMPLER_PREFETCH_FRAMES ahead
+        if (synth->modules[i].tag == MODULE_Sampler) {
+            struct Sampler *sampler = synth->modules[i].ptr;
+            size_t pos = sampler->_priv.isPlaying ? (size_t) sampler->_priv.pos : SAMPLER_PLAYER_IDLE;
+            samplePlayerPublish(sampler->sample, sampler->_priv.player, pos);
+        }
+    }
+}
+
+// stereo patches are folded down to mid here
+void synthRunBlock(struct Synth *synth, int16_t *outBuf, size_t frames) {
+    if (frames == 0) return;
+    // a graph that can't init plays silence rather than whatever was in outBuf
+    if (synthBlockBegin(synth) != 0) {
+        memset(outBuf, 0, frames * sizeof(int16_t));
+        return;
+    }
+    for (size_t frame = 0; frame < frames; frame++) {
+        synthBlockFrame(synth, frame, frames);
+        if (synth->outPtrRight != NULL) {
+            outBuf[frame] = (*synth->outPtr + *synth->outPtrRight) / 2;
+        } else {
+            outBuf[frame] = *synth->outPtr;
+        }
+    }
+    synthBlockEnd(synth, frames);
+}
+
+// interleaved L/R, mono patches land on both channels
+void synthRunBlockStereo(struct Synth *synth, int16_t *outBuf, size_t frames) {
+    if (frames == 0) return;
+    if (synthBlockBegin(synth) != 0) {
+        memset(outBuf, 0, 2 * frames * sizeof(int16_t));
+        return;
+    }
+    for (size_t frame = 0; frame < frames; frame++) {
+        synthBlockFrame(synth, frame, frames);
+        outBuf[2 * frame] = *synth->outPtr;
+        outBuf[2 * frame + 1] = synth->outPtrRight != NULL ? *synth->outPtrRight : *synth->outPtr;
+    }
+    synthBlockEnd(synth, frames);
 }
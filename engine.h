@@ -4,13 +4,25 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "arena.h"
+#include "noise.h"
+
 #define M_TAU 6.28318530717958647692
 
-#define SAMPLE_RATE 44100
+#define DEFAULT_SAMPLE_RATE 44100
+// logf(DEFAULT_SAMPLE_RATE / 2 - MIDDLE_C_FREQ); pitch samples keep this range
+// whatever rate the stream runs at, so a patch plays the same notes on every device
+#define FREQ_SAMPLE_LOG_MAX 9.98913162f
 #define STREAM_BUF_SIZE 1024
 #define MIDDLE_C_FREQ 261.63
 #define FILTER_BUF_SIZE 512
 #define MODULE_BUF_SIZE 16
+#define UNISON_MAX_VOICES 16
+#define UNISON_MAX_DETUNE_CENTS 100
+#define DELAY_MAX_TIME_MS 10000
+#define DELAY_MAX_FEEDBACK 0.98f
+#define REVERB_MAX_LINES 16
+#define REVERB_MAX_SIZE 2.0f
 
 enum Waveform {
     WAV_Sine,
@@ -20,6 +32,13 @@ enum Waveform {
     WAV_Noise
 };
 
+enum NoiseColor {
+    NOISE_White,
+    NOISE_Pink,
+    // new random points at freqSample, interpolated between
+    NOISE_Band,
+};
+
 enum FirWindowType {
     WINDOW_Rectangular,
     WINDOW_Hamming,
@@ -52,6 +71,23 @@ struct Oscillator {
 
     struct {
         uint16_t t;
+        struct NoiseGen noise;
+    } _priv;
+};
+
+struct Noise {
+    int16_t *amt;
+    int16_t *color;
+    int16_t *freqSample;
+    // 0 derives the seed from srandqd's seed and the module's index
+    uint32_t seed;
+
+    struct {
+        struct NoiseGen gen;
+        float pink[7];
+        float bandPhase;
+        int16_t bandPrev;
+        int16_t bandNext;
     } _priv;
 };
 
@@ -63,6 +99,8 @@ struct EnvelopeAd {
 
     struct {
         uint32_t t;
+        uint32_t attackPeriod;
+        uint32_t decayPeriod;
         enum EnvelopeStage stage;
     } _priv;
 };
@@ -75,6 +113,8 @@ struct EnvelopeAr {
 
     struct {
         uint32_t t;
+        uint32_t attackPeriod;
+        uint32_t releasePeriod;
         enum EnvelopeStage stage;
     } _priv;
 };
@@ -88,6 +128,9 @@ struct EnvelopeAdr {
 
     struct {
         uint32_t t;
+        uint32_t attackPeriod;
+        uint32_t decayPeriod;
+        uint32_t releasePeriod;
         int16_t releaseSample;
         enum EnvelopeStage stage;
     } _priv;
@@ -103,6 +146,9 @@ struct EnvelopeAdsr {
 
     struct {
         uint32_t t;
+        uint32_t attackPeriod;
+        uint32_t decayPeriod;
+        uint32_t releasePeriod;
         int16_t releaseSample;
         enum EnvelopeStage stage;
     } _priv;
@@ -119,6 +165,10 @@ struct EnvelopeAdbdr {
 
     struct {
         uint32_t t;
+        uint32_t attackPeriod;
+        uint32_t decay1Period;
+        uint32_t decay2Period;
+        uint32_t releasePeriod;
         int16_t releaseSample;
         enum EnvelopeStage stage;
     } _priv;
@@ -150,11 +200,123 @@ struct Filter {
     enum FirWindowType window;
 
     struct {
-        float windowBuf[FILTER_BUF_SIZE];
-        float impulseResponse[FILTER_BUF_SIZE];
-        int16_t samplesBuf[FILTER_BUF_SIZE];
+        // impulseLen long each, laid out by synthInit
+        float *windowBuf;
+        float *impulseResponse;
+        int16_t *samplesBuf;
         size_t samplesBufIdx;
         int16_t prevCutoff;
+        // how much of the history repeats lastIn, an idle filter holds still
+        // once that covers the whole impulse
+        int16_t lastIn;
+        size_t quietLen;
+    } _priv;
+};
+
+// up to UNISON_MAX_VOICES detuned band-limited saws, one SIMD lane per voice
+struct Unison {
+    int16_t *freqSample;
+    int16_t *amt;
+    // spread of the voices' pitch, up to UNISON_MAX_DETUNE_CENTS either side
+    int16_t *detune;
+    // level of the outer voices against the centre ones
+    int16_t *spread;
+    // how far the voices are panned apart
+    int16_t *width;
+    size_t voices;
+
+    // the module's out is the mid signal, these carry the stereo pair
+    int16_t outLeft;
+    int16_t outRight;
+
+    struct {
+        float phase[UNISON_MAX_VOICES];
+        float phaseInc[UNISON_MAX_VOICES];
+        float gainLeft[UNISON_MAX_VOICES];
+        float gainRight[UNISON_MAX_VOICES];
+        int16_t prevFreqSample;
+        int16_t prevDetune;
+        int16_t prevAmt;
+        int16_t prevSpread;
+        int16_t prevWidth;
+        bool isInit;
+    } _priv;
+};
+
+struct Delay {
+    int16_t *sampleIn;
+    // sweeps 0 to maxTimeMs, glides rather than jumps when modulated
+    int16_t *time;
+    int16_t *feedback;
+    int16_t *mix;
+    size_t maxTimeMs;
+
+    struct {
+        float *buf;
+        size_t mask;
+        size_t writeIdx;
+        float delayFrames;
+    } _priv;
+};
+
+// feedback delay network: 8 or 16 lines mixed through a hadamard matrix
+struct Reverb {
+    int16_t *sampleIn;
+    // scales the line lengths, up to REVERB_MAX_SIZE
+    float *roomSize;
+    // time for the tail to fall by 60dB
+    float *decayMs;
+    int16_t *damping;
+    int16_t *mix;
+    size_t lines;
+
+    int16_t outLeft;
+    int16_t outRight;
+
+    struct {
+        float *buf;
+        size_t mask;
+        size_t writeIdx;
+        size_t delay[REVERB_MAX_LINES];
+        float gain[REVERB_MAX_LINES];
+        float lowpass[REVERB_MAX_LINES];
+    } _priv;
+};
+
+struct SampleData;
+
+struct Sampler {
+    struct SampleData *sample;
+    bool *gate;
+    int16_t *freqSample;
+    int16_t *amt;
+    // pitch that plays the file back at its recorded speed, middle C if unset
+    float *rootFreq;
+
+    struct {
+        double pos;
+        bool prevGate;
+        bool isPlaying;
+        // slot in sample's player table, -1 without one
+        int player;
+    } _priv;
+};
+
+struct WavetableBank;
+
+struct WavetableOsc {
+    struct WavetableBank *bank;
+    int16_t *freqSample;
+    int16_t *amt;
+    // sweeps from the first frame of the bank at INT16_MIN to the last at INT16_MAX
+    int16_t *position;
+
+    struct {
+        float phase;
+        float phaseInc;
+        size_t level;
+        int16_t prevFreqSample;
+        bool isInit;
     } _priv;
 };
 
@@ -170,24 +332,185 @@ enum SynthModuleType {
     MODULE_Attenuator,
     MODULE_Mixer,
     MODULE_Filter,
+    MODULE_Sampler,
+    MODULE_WavetableOsc,
+    MODULE_Noise,
+    MODULE_Unison,
+    MODULE_Delay,
+    MODULE_Reverb,
+
+    MODULE_TYPE_COUNT
+};
+
+enum PortKind {
+    PORT_Sample,
+    PORT_Float,
+    PORT_Gate,
+    PORT_SampleList,
+    PORT_Size,
+    PORT_Window,
+    PORT_SampleData,
+    PORT_Wavetable,
+    PORT_Seed,
+};
+
+// describes one input or config field of a module struct, so loaders can
+// build modules by name without knowing their layout
+struct ModulePort {
+    const char *name;
+    enum PortKind kind;
+    size_t offset;
+    bool isOptional;
+    // upper bound for by-value sizes
+    uint32_t maxValue;
+};
+
+struct ModuleInfo {
+    const char *name;
+    size_t size;
+    const struct ModulePort *ports;
+    size_t portsLen;
+    // stereo modules also expose a left/right pair inside their struct
+    bool isStereo;
+    size_t outLeftOffset;
+    size_t outRightOffset;
 };
 
 struct SynthModule {
     void *ptr;
     enum SynthModuleType tag;
     int16_t out;
+    struct {
+        // how much of the current block the module has to compute
+        uint8_t activity;
+        // its parameters changed since the last block
+        bool isRefreshed;
+    } _priv;
+};
+
+struct SynthRate {
+    float sampleRate;
+    float framesPerMs;
+    float radPerFrame;
+};
+
+struct ModuleVersion;
+
+// bytes of a synth's state arena, by how often they're touched
+struct SynthFootprint {
+    // module table, bodies and input lists, walked every frame in schedule order
+    size_t hot;
+    // filter taps and history, delay lines
+    size_t buffers;
+    // tables only read when a parameter changes, e.g. filter windows
+    size_t cold;
+};
+
+// independent branches of one patch render a chunk each on the worker pool,
+// then the modules joining them run over the branches' captured outputs
+#define SYNTH_SCHED_CHUNK 256
+#define SYNTH_MAX_TASKS 16
+
+struct SynthSchedule {
+    // module indices by task, the tail (task tasksLen) last, each in table order
+    uint32_t *order;
+    // tasksLen + 2 entries into order
+    uint32_t *taskStart;
+    // branch modules the tail reads, by task, and where each task's start
+    uint32_t *exports;
+    uint32_t *exportStart;
+    // SYNTH_SCHED_CHUNK frames of out per export
+    int16_t *captures;
+    // 0 renders every module on the calling thread
+    size_t tasksLen;
 };
 
 struct Synth {
     struct SynthModule *modules;
     size_t modulesLen;
+    float sampleRate;
+    // threads a block may use, 0 picks from the cpu count, 1 keeps it serial
+    int maxThreads;
+    struct Arena arena;
     struct {
+        struct SynthRate rate;
+        // synthInit packs the modules and everything they allocate in here,
+        // modules then points into it
+        struct Arena state;
+        struct SynthFootprint footprint;
+        // room in the table synthCreate made for synthAddModule
+        size_t modulesCap;
+        // modules that run on every frame of the current block
+        uint32_t *runList;
+        size_t runListLen;
+        // one per module, bumped by synthSetParam and synthTouch
+        struct ModuleVersion *versions;
+        struct SynthSchedule sched;
         bool isInit;
     } _priv;
     int16_t *outPtr;
+    // set for stereo patches, outPtr is the left channel then
+    int16_t *outPtrRight;
+};
+
+// a constant or host value for one port of a module being added
+struct SynthParam {
+    const char *port;
+    // Sample ports take the raw sample, e.g. floatToAmt(0.5), Size, Window,
+    // Gate and Seed ports the integer value
+    double value;
+    // points the port at a host owned value instead, e.g. the played note
+    void *hostPtr;
 };
 
+// longest SampleList synthConnect can grow
+#define SYNTH_MAX_LIST_LEN 32
+
+// runtime graph building, all from one arena sized for maxModules. modules
+// are returned as handles, indices into synth->modules that stay valid for
+// the synth's lifetime. errors are reported on stderr and return -1
+int synthCreate(struct Synth *synth, size_t maxModules);
+int synthAddModule(struct Synth *synth, enum SynthModuleType tag, const struct SynthParam *params, size_t paramsLen);
+// points dst's port at src's output, SampleList ports gain another entry
+int synthConnect(struct Synth *synth, int src, int dst, const char *port);
+// stereo modules set both channels
+int synthSetOut(struct Synth *synth, int module);
+
+// changes a parameter of a built synth; module state derived from it is
+// rebuilt when the next block starts. Sample, Float and Gate ports that hold
+// a constant or host value can change, and so can a filter's window.
+// safe to call from another thread than the one rendering
+int synthSetParam(struct Synth *synth, int module, const char *port, double value);
+// for hosts that write a module's parameters through their own pointers.
+// derived state only follows such writes once the module is touched: a host
+// pointer bound to an envelope's attackMs, decayMs, releaseMs and the like
+// keeps its old period until synthTouch, where it used to be re-read every
+// sample. WavetableOsc and Unison pitch, Unison gains and Filter cutoff are
+// the exception, they're compared every sample because other modules can
+// drive them at audio rate
+void synthTouch(struct Synth *synth, int module);
+
+// -1 when a required port is unbound or the state arena can't be allocated
+int synthInit(struct Synth *synth);
+void synthDestroy(struct Synth *synth);
+struct SynthFootprint synthFootprint(const struct Synth *synth);
+const struct ModuleInfo *synthModuleInfo(enum SynthModuleType tag);
 void synthRun(struct Synth *synth);
+// every envelope has played out and is finished or waiting for a new gate,
+// so once the gate is off only effect tails can still sound
+bool synthIsReleased(const struct Synth *synth);
+// whether module runs on every frame of the block last rendered, rather than
+// holding a constant or sitting idle
+bool synthModuleIsActive(const struct Synth *synth, int module);
+// longest delay or reverb line in frames, after synthInit. output that has
+// been silent for longer has no echo left to come back
+size_t synthLongestLine(const struct Synth *synth);
+// host inputs are read as fixed for the whole block, which lets modules whose
+// output can't change (silent voices, settled filters) skip it
+void synthRunBlock(struct Synth *synth, int16_t *outBuf, size_t frames);
+void synthRunBlockStereo(struct Synth *synth, int16_t *outBuf, size_t frames);
+
+void createFirWindow(float *windowBuf, enum FirWindowType window, size_t impulseLen);
 
 float sampleToFreq(int16_t sample);
 int16_t freqToSample(float freq);
@@ -205,6 +528,6 @@ void sftTest(void);
 void slowFourierTransform(int16_t *sampleBuf, Cplx *outBuf, size_t bufLen);
 void cplxPrint(Cplx z);
 
-void srandqd(int32_t seed);
+void srandqd(uint32_t seed);
 
 #endif //ENGINE_H
@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "event.h"
+
+static int64_t nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int eventLoopInit(struct EventLoop *loop, int tickMs) {
+    loop->inLen = 0;
+    loop->inDeadlineMs = 0;
+    loop->onKey = NULL;
+    loop->onTick = NULL;
+    loop->onWake = NULL;
+    loop->userdata = NULL;
+    atomic_init(&loop->isRunning, false);
+
+    loop->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (loop->timerFd < 0) return -1;
+
+    loop->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (loop->wakeFd < 0) {
+        close(loop->timerFd);
+        return -1;
+    }
+
+    loop->tickMs = 0;
+    eventLoopSetTick(loop, tickMs);
+    return 0;
+}
+
+void eventLoopSetTick(struct EventLoop *loop, int tickMs) {
+    if (tickMs < 0) tickMs = 0;
+    if (tickMs == loop->tickMs) return;
+
+    // an all zero itimerspec disarms the timer
+    struct itimerspec tick = {
+        .it_interval = { .tv_sec = tickMs / 1000, .tv_nsec = (tickMs % 1000) * 1000000L },
+        .it_value = { .tv_sec = tickMs / 1000, .tv_nsec = (tickMs % 1000) * 1000000L },
+    };
+    if (timerfd_settime(loop->timerFd, 0, &tick, NULL) == 0) loop->tickMs = tickMs;
+}
+
+void eventLoopDestroy(struct EventLoop *loop) {
+    close(loop->timerFd);
+    close(loop->wakeFd);
+}
+
+void eventLoopWake(struct EventLoop *loop) {
+    uint64_t one = 1;
+    ssize_t ret = write(loop->wakeFd, &one, sizeof(one));
+    (void) ret;
+}
+
+void eventLoopStop(struct EventLoop *loop) {
+    atomic_store(&loop->isRunning, false);
+    eventLoopWake(loop);
+}
+
+static int csiKey(char final, int param) {
+    switch (final) {
+    case 'A': return KEY_UP;
+    case 'B': return KEY_DOWN;
+    case 'C': return KEY_RIGHT;
+    case 'D': return KEY_LEFT;
+    case 'H': return KEY_HOME;
+    case 'F': return KEY_END;
+    case '~':
+        switch (param) {
+        case 1: case 7: return KEY_HOME;
+        case 2: return KEY_INSERT;
+        case 3: return KEY_DELETE;
+        case 4: case 8: return KEY_END;
+        case 5: return KEY_PAGE_UP;
+        case 6: return KEY_PAGE_DOWN;
+        default: return KEY_NONE;
+        }
+    default: return KEY_NONE;
+    }
+}
+
+// returns the bytes consumed, or 0 when an escape sequence is still incomplete
+static size_t parseKey(const char *buf, size_t len, bool isFinal, struct KeyEvent *event) {
+    event->key = KEY_NONE;
+    event->mods = 0;
+
+    if (buf[0] != '\033') {
+        event->key = (unsigned char) buf[0];
+        return 1;
+    }
+
+    if (len == 1) {
+        if (!isFinal) return 0;
+        event->key = KEY_ESC;
+        return 1;
+    }
+
+    if (buf[1] != '[' && buf[1] != 'O') {
+        event->key = (unsigned char) buf[1];
+        event->mods = MOD_ALT;
+        return 2;
+    }
+
+    // CSI/SS3: numeric parameters separated by ';' up to a final byte,
+    // the second parameter carries the modifiers as 1 + bitmask
+    int params[2] = { 0, 0 };
+    int paramIdx = 0;
+    size_t i;
+    for (i = 2; i < len; i++) {
+        char c = buf[i];
+        if (c >= '0' && c <= '9') {
+            if (paramIdx < 2) params[paramIdx] = params[paramIdx] * 10 + c - '0';
+        } else if (c == ';') {
+            ++paramIdx;
+        } else {
+            break;
+        }
+    }
+
+    // a sequence that was cut off isn't a key, and none of its bytes are
+    if (i == len) return isFinal ? len : 0;
+
+    event->key = csiKey(buf[i], params[0]);
+    if (paramIdx >= 1 && params[1] > 1) {
+        event->mods = params[1] - 1;
+    }
+    return i + 1;
+}
+
+static void dispatchKeys(struct EventLoop *loop, bool isFinal) {
+    size_t pos = 0;
+
+    if (loop->inLen == EVENT_IN_BUF_SIZE) isFinal = true;
+
+    while (pos < loop->inLen) {
+        struct KeyEvent event;
+        size_t used = parseKey(loop->inBuf + pos, loop->inLen - pos, isFinal, &event);
+        if (used == 0) break;
+
+        pos += used;
+        if (event.key != KEY_NONE && loop->onKey != NULL) {
+            loop->onKey(event, loop->userdata);
+        }
+    }
+
+    memmove(loop->inBuf, loop->inBuf + pos, loop->inLen - pos);
+    loop->inLen -= pos;
+}
+
+void eventLoopRun(struct EventLoop *loop) {
+    struct pollfd fds[] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = loop->timerFd, .events = POLLIN },
+        { .fd = loop->wakeFd, .events = POLLIN },
+    };
+
+    atomic_store(&loop->isRunning, true);
+
+    while (atomic_load(&loop->isRunning)) {
+        int timeoutMs = -1;
+        if (loop->inLen > 0) {
+            int64_t left = loop->inDeadlineMs - nowMs();
+            timeoutMs = left > 0 ? (int) left : 0;
+        }
+        int ret = poll(fds, sizeof(fds) / sizeof(fds[0]), timeoutMs);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t len = read(STDIN_FILENO, loop->inBuf + loop->inLen, EVENT_IN_BUF_SIZE - loop->inLen);
+            if (len > 0) {
+                loop->inLen += len;
+                loop->inDeadlineMs = nowMs() + EVENT_ESC_TIMEOUT_MS;
+                dispatchKeys(loop, false);
+            } else if (len == 0) {
+                atomic_store(&loop->isRunning, false);
+            }
+        } else if (fds[0].revents & (POLLHUP | POLLERR)) {
+            atomic_store(&loop->isRunning, false);
+        }
+
+        // nothing followed a partial escape sequence in time, so it was a
+        // plain ESC. checked whichever fd woke poll, a fast ui timer can wake
+        // it before the timeout every time
+        if (loop->inLen > 0 && nowMs() >= loop->inDeadlineMs) dispatchKeys(loop, true);
+
+        uint64_t count;
+        if (fds[1].revents & POLLIN && read(loop->timerFd, &count, sizeof(count)) > 0) {
+            if (loop->onTick != NULL) loop->onTick(loop->userdata);
+        }
+        if (fds[2].revents & POLLIN && read(loop->wakeFd, &count, sizeof(count)) > 0) {
+            if (loop->onWake != NULL) loop->onWake(loop->userdata);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVENT_IN_BUF_SIZE 64
+// how long a lone ESC waits for the rest of an escape sequence
+#define EVENT_ESC_TIMEOUT_MS 25
+
+// printable keys keep their character code, everything else starts at KEY_ESC
+enum Key {
+    KEY_NONE = 0,
+    KEY_ESC = 0x100,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_RIGHT,
+    KEY_LEFT,
+    KEY_HOME,
+    KEY_END,
+    KEY_INSERT,
+    KEY_DELETE,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+};
+
+enum KeyMod {
+    MOD_SHIFT = 1 << 0,
+    MOD_ALT = 1 << 1,
+    MOD_CTRL = 1 << 2,
+};
+
+struct KeyEvent {
+    int key;
+    unsigned mods;
+};
+
+struct EventLoop {
+    int timerFd;
+    // period the timer is armed with, 0 while it's off
+    int tickMs;
+    int wakeFd;
+    char inBuf[EVENT_IN_BUF_SIZE];
+    size_t inLen;
+    // CLOCK_MONOTONIC ms after which pending input stops waiting for the rest
+    // of its escape sequence
+    int64_t inDeadlineMs;
+    atomic_bool isRunning;
+
+    void (*onKey)(struct KeyEvent event, void *userdata);
+    void (*onTick)(void *userdata);
+    void (*onWake)(void *userdata);
+    void *userdata;
+};
+
+// one thread polls stdin, a periodic timer and a wakeup fd, and dispatches to
+// the callbacks; any thread may eventLoopWake or eventLoopStop it
+int eventLoopInit(struct EventLoop *loop, int tickMs);
+// rearms the onTick timer, 0 stops it. loop thread only
+void eventLoopSetTick(struct EventLoop *loop, int tickMs);
+void eventLoopRun(struct EventLoop *loop);
+void eventLoopWake(struct EventLoop *loop);
+void eventLoopStop(struct EventLoop *loop);
+void eventLoopDestroy(struct EventLoop *loop);
+
+#endif //EVENT_H
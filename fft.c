@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "fft.h"
+
+static bool isPow2(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+struct FftPlan *fftPlanCreate(size_t len) {
+    if (len < 4 || !isPow2(len)) return NULL;
+
+    size_t halfLen = len / 2;
+    size_t bits = 0;
+    while (((size_t) 1 << bits) < halfLen) bits++;
+
+    // one allocation: plan, complex twiddles, real split twiddles, bit-reversal table
+    struct FftPlan *plan = malloc(
+        sizeof(struct FftPlan)
+        + halfLen / 2 * sizeof(Cplx)
+        + (halfLen / 2 + 1) * sizeof(Cplx)
+        + halfLen * sizeof(uint32_t));
+    if (plan == NULL) return NULL;
+
+    plan->len = len;
+    plan->twiddles = (Cplx *) (plan + 1);
+    plan->splitTwiddles = plan->twiddles + halfLen / 2;
+    plan->bitRev = (uint32_t *) (plan->splitTwiddles + halfLen / 2 + 1);
+
+    for (size_t k = 0; k < halfLen / 2; k++) {
+        plan->twiddles[k] = (Cplx){
+            .real = cos(M_TAU * k / halfLen),
+            .imag = -sin(M_TAU * k / halfLen)
+        };
+    }
+    for (size_t k = 0; k <= halfLen / 2; k++) {
+        plan->splitTwiddles[k] = (Cplx){
+            .real = cos(M_TAU * k / len),
+            .imag = -sin(M_TAU * k / len)
+        };
+    }
+    for (size_t i = 0; i < halfLen; i++) {
+        uint32_t rev = 0;
+        for (size_t b = 0; b < bits; b++) {
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->bitRev[i] = rev;
+    }
+
+    return plan;
+}
+
+void fftPlanDestroy(struct FftPlan *plan) {
+    free(plan);
+}
+
+// complex FFT over len / 2 interleaved (real, imag) pairs, unnormalised
+static void fftComplex(const struct FftPlan *plan, float *buf, bool inverse) {
+    size_t n = plan->len / 2;
+    size_t half = 1;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t j = plan->bitRev[i];
+        if (j > i) {
+            float re = buf[2 * i];
+            float im = buf[2 * i + 1];
+            buf[2 * i] = buf[2 * j];
+            buf[2 * i + 1] = buf[2 * j + 1];
+            buf[2 * j] = re;
+            buf[2 * j + 1] = im;
+        }
+    }
+
+    // the first two radix-2 stages only use the twiddles 1 and -j, so fuse them
+    // into one multiplication-free radix-4 pass
+    if (n >= 4) {
+        for (size_t start = 0; start < n; start += 4) {
+            float *x = buf + 2 * start;
+            float s01r = x[0] + x[2], s01i = x[1] + x[3];
+            float d01r = x[0] - x[2], d01i = x[1] - x[3];
+            float s23r = x[4] + x[6], s23i = x[5] + x[7];
+            float d23r = x[4] - x[6], d23i = x[5] - x[7];
+            // d23 * -j forward, d23 * j inverse
+            float rotr = inverse ? -d23i : d23i;
+            float roti = inverse ? d23r : -d23r;
+
+            x[0] = s01r + s23r;
+            x[1] = s01i + s23i;
+            x[4] = s01r - s23r;
+            x[5] = s01i - s23i;
+            x[2] = d01r + rotr;
+            x[3] = d01i + roti;
+            x[6] = d01r - rotr;
+            x[7] = d01i - roti;
+        }
+        half = 4;
+    }
+
+    for (; half < n; half *= 2) {
+        size_t stride = n / (2 * half);
+        for (size_t start = 0; start < n; start += 2 * half) {
+            for (size_t k = 0; k < half; k++) {
+                Cplx w = plan->twiddles[k * stride];
+                if (inverse) w.imag = -w.imag;
+
+                float *a = buf + 2 * (start + k);
+                float *b = buf + 2 * (start + k + half);
+                float tr = b[0] * w.real - b[1] * w.imag;
+                float ti = b[0] * w.imag + b[1] * w.real;
+
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+void fftRealForward(const struct FftPlan *plan, float *buf) {
+    size_t n = plan->len / 2;
+
+    fftComplex(plan, buf, false);
+
+    float dc = buf[0] + buf[1];
+    float nyquist = buf[0] - buf[1];
+    buf[0] = dc;
+    buf[1] = nyquist;
+
+    // untangle the even/odd halves of bins k and n - k together
+    for (size_t k = 1; k <= n / 2; k++) {
+        size_t m = n - k;
+        float zkr = buf[2 * k], zki = buf[2 * k + 1];
+        float zmr = buf[2 * m], zmi = buf[2 * m + 1];
+
+        float evenr = 0.5f * (zkr + zmr);
+        float eveni = 0.5f * (zki - zmi);
+        float oddr = 0.5f * (zki + zmi);
+        float oddi = -0.5f * (zkr - zmr);
+
+        Cplx w = plan->splitTwiddles[k];
+        float tr = w.real * oddr - w.imag * oddi;
+        float ti = w.real * oddi + w.imag * oddr;
+
+        buf[2 * k] = evenr + tr;
+        buf[2 * k + 1] = eveni + ti;
+        buf[2 * m] = evenr - tr;
+        buf[2 * m + 1] = ti - eveni;
+    }
+}
+
+void fftRealInverse(const struct FftPlan *plan, float *buf) {
+    size_t n = plan->len / 2;
+
+    float dc = buf[0];
+    float nyquist = buf[1];
+    buf[0] = 0.5f * (dc + nyquist);
+    buf[1] = 0.5f * (dc - nyquist);
+
+    for (size_t k = 1; k <= n / 2; k++) {
+        size_t m = n - k;
+        float xkr = buf[2 * k], xki = buf[2 * k + 1];
+        float xmr = buf[2 * m], xmi = buf[2 * m + 1];
+
+        float evenr = 0.5f * (xkr + xmr);
+        float eveni = 0.5f * (xki - xmi);
+        float dr = 0.5f * (xkr - xmr);
+        float di = 0.5f * (xki + xmi);
+
+        Cplx w = plan->splitTwiddles[k];
+        float oddr = dr * w.real + di * w.imag;
+        float oddi = di * w.real - dr * w.imag;
+
+        buf[2 * k] = evenr - oddi;
+        buf[2 * k + 1] = eveni + oddr;
+        buf[2 * m] = evenr + oddi;
+        buf[2 * m + 1] = oddr - eveni;
+    }
+
+    fftComplex(plan, buf, true);
+
+    float scale = 1.0f / n;
+    for (size_t i = 0; i < plan->len; i++) {
+        buf[i] *= scale;
+    }
+}
+
+Cplx fftRealBin(const struct FftPlan *plan, const float *buf, size_t k) {
+    if (k == 0) return (Cplx){ .real = buf[0] };
+    if (k == plan->len / 2) return (Cplx){ .real = buf[1] };
+    return (Cplx){ .real = buf[2 * k], .imag = buf[2 * k + 1] };
+}
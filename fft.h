@@ -0,0 +1,25 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// real-input FFT of a fixed power-of-two length. the spectrum is packed in place:
+// buf[0] = DC, buf[1] = Nyquist, buf[2k], buf[2k + 1] = real/imag of bin k (0 < k < len / 2)
+struct FftPlan {
+    size_t len;
+    uint32_t *bitRev;
+    Cplx *twiddles;
+    Cplx *splitTwiddles;
+};
+
+struct FftPlan *fftPlanCreate(size_t len);
+void fftPlanDestroy(struct FftPlan *plan);
+
+void fftRealForward(const struct FftPlan *plan, float *buf);
+void fftRealInverse(const struct FftPlan *plan, float *buf);
+Cplx fftRealBin(const struct FftPlan *plan, const float *buf, size_t k);
+
+#endif //FFT_H
@@ -1,31 +1,169 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <soundio/soundio.h>
 
+#include <errno.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include "batch.h"
+#include "pool.h"
+#include "rtcheck.h"
+#include "rtsched.h"
 #include "engine.h"
 #include "tui.h"
-
-#define NULL_TERM_ARR(type, ...) (type[]) {__VA_ARGS__, NULL}
-#define MODULE(T, ...) (struct SynthModule){ .tag = MODULE_ ## T, .ptr = &(struct T){__VA_ARGS__ }}
-
-#define PTR(x) &(int16_t){x}
-#define PTRF(x) &(float){x}
+#include "output.h"
+#include "ring.h"
+#include "event.h"
+#include "patch.h"
+#include "swap.h"
+#include "sampler.h"
+#include "wavetable.h"
+
+#define PARAMS(...) (struct SynthParam[]){ __VA_ARGS__ }, \
+    sizeof((struct SynthParam[]){ __VA_ARGS__ }) / sizeof(struct SynthParam)
+#define VAL(port, value) { port, value, NULL }
+#define HOST(port, ptr) { port, 0, ptr }
+#define CTRL_KEY(c) ((c) & 0x1f)
+// while nothing on screen changes the ui only ticks this often, to reclaim
+// swapped out synths and notice stream errors
+#define UI_IDLE_TICK_MS 1000
+// -l, a bit over a second at 48 kHz
+#define BUFFER_MAX_FRAMES 65536
 
 typedef struct Oscillator Oscillator;
 
 struct Userdata {
-    struct Synth *synth;
+    struct SynthSwap swap;
+    struct Synth *mainSynth;
+    const char *patchPath;
+    float sampleRate;
+    struct SampleData samples[SAMPLER_MAX_FILES];
+    const char *sampleNames[SAMPLER_MAX_FILES];
+    size_t samplesLen;
+    struct SamplePrefetcher prefetcher;
+    struct WavetableBank *banks[WAVETABLE_MAX_BANKS];
+    const char *bankNames[WAVETABLE_MAX_BANKS];
+    size_t banksLen;
+    struct Tui *tui;
+    struct EventLoop *loop;
+    // tick period while the tui has something to draw, from -f
+    int frameMs;
+    struct SampleRing outputTap;
     int16_t inputFreq;
     bool gate;
-    bool quit;
+    // keys have no velocity, patches written for batch renders get full scale
+    int16_t velocity;
+    // the callback can't print or exit, it leaves the first soundio error here
+    // for the ui thread to stop on
+    atomic_int streamError;
+    // whichever thread the backend calls back on, published on the first call
+    // so the main thread can raise and pin it
+    pthread_t audioThread;
+    atomic_bool hasAudioThread;
 };
 
 
-void updateInput(struct Userdata *userdata) {
-    int curChar = getchar();
-    switch (curChar) {
+// the samples and wavetables loaded with -s and -w, as patch inputs
+size_t sharedInputs(struct Userdata *userdata, struct PatchInput *inputs) {
+    size_t inputsLen = 0;
+    for (size_t i = 0; i < userdata->samplesLen; i++) {
+        inputs[inputsLen++] = (struct PatchInput){ userdata->sampleNames[i], PORT_SampleData, &userdata->samples[i] };
+    }
+    for (size_t i = 0; i < userdata->banksLen; i++) {
+        inputs[inputsLen++] = (struct PatchInput){ userdata->bankNames[i], PORT_Wavetable, userdata->banks[i] };
+    }
+    return inputsLen;
+}
+
+int loadPatch(struct Userdata *userdata, struct Synth *synth) {
+    struct PatchInput inputs[3 + SAMPLER_MAX_FILES + WAVETABLE_MAX_BANKS] = {
+        { "freq", PORT_Sample, &userdata->inputFreq },
+        { "gate", PORT_Gate, &userdata->gate },
+        { "velocity", PORT_Sample, &userdata->velocity },
+    };
+    size_t inputsLen = 3 + sharedInputs(userdata, inputs + 3);
+    return patchLoadFile(synth, userdata->patchPath, inputs, inputsLen);
+}
+
+// a square and an enveloped saw through a low-pass filter, patches/default.patch
+// spells out the same graph
+int buildDefaultPatch(struct Userdata *userdata, struct Synth *synth) {
+    if (synthCreate(synth, 5) != 0) return -1;
+
+    int square = synthAddModule(synth, MODULE_Oscillator, PARAMS(
+        HOST("freqSample", &userdata->inputFreq),
+        VAL("waveform", WAV_Square),
+        VAL("amt", floatToAmt(0.25)),
+    ));
+    int saw = synthAddModule(synth, MODULE_Oscillator, PARAMS(
+        HOST("freqSample", &userdata->inputFreq),
+        VAL("waveform", WAV_Saw),
+    ));
+    int mix = synthAddModule(synth, MODULE_Mixer, NULL, 0);
+    int lowpass = synthAddModule(synth, MODULE_Filter, PARAMS(
+        VAL("impulseLen", 128),
+        VAL("window", WINDOW_Blackman),
+    ));
+    int env = synthAddModule(synth, MODULE_EnvelopeAdsr, PARAMS(
+        HOST("gate", &userdata->gate),
+        VAL("attackMs", 500),
+        VAL("decayMs", 500),
+        VAL("sustain", floatToAmt(0.2)),
+        VAL("releaseMs", 2000),
+        VAL("easing", 0.8),
+    ));
+    if (square < 0 || saw < 0 || mix < 0 || lowpass < 0 || env < 0) return -1;
+
+    if (synthConnect(synth, env, saw, "amt")
+        || synthConnect(synth, square, mix, "samplesIn")
+        || synthConnect(synth, saw, mix, "samplesIn")
+        || synthConnect(synth, mix, lowpass, "sampleIn")
+        || synthConnect(synth, env, lowpass, "cutoff")) {
+        return -1;
+    }
+    return synthSetOut(synth, saw);
+}
+
+void releaseSynth(struct Userdata *userdata, struct Synth *synth) {
+    synthDestroy(synth);
+    if (synth != userdata->mainSynth) free(synth);
+}
+
+// rebuilds the patch from disk and swaps it in while audio keeps running
+void reloadPatch(struct Userdata *userdata) {
+    if (userdata->patchPath == NULL) return;
+
+    struct Synth *synth = calloc(1, sizeof(*synth));
+    if (synth == NULL) return;
+    synth->sampleRate = userdata->sampleRate;
+    if (loadPatch(userdata, synth) != 0) {
+        free(synth);
+        return;
+    }
+
+    struct Synth *superseded;
+    if (swapPublish(&userdata->swap, synth, &superseded) != 0) {
+        synthDestroy(synth);
+        free(synth);
+        return;
+    }
+    if (superseded != NULL) releaseSynth(userdata, superseded);
+}
+
+// frames at the -f rate while anything on screen is animated or dirty
+void scheduleFrames(struct Userdata *userdata) {
+    eventLoopSetTick(userdata->loop, tuiIsIdle(userdata->tui) ? UI_IDLE_TICK_MS : userdata->frameMs);
+}
+
+void updateInput(struct KeyEvent event, void *data) {
+    struct Userdata *userdata = data;
+    switch (event.key) {
     case '\0':
         break;
     case '[':
@@ -35,98 +173,256 @@ void updateInput(struct Userdata *userdata) {
         userdata->gate = false;
         break;
     case 'q':
-        userdata->quit = true;
+        eventLoopStop(userdata->loop);
+        break;
+    case CTRL_KEY('r'):
+        reloadPatch(userdata);
         break;
     default:
+        if (event.key >= KEY_ESC || event.mods != 0) break;
         userdata->gate = true;
-        userdata->inputFreq = freqToSample(100 * powf(2, (curChar - 48) / 12.0f));
+        userdata->inputFreq = freqToSample(100 * powf(2, (event.key - 48) / 12.0f));
         break;
     }
+    scheduleFrames(userdata);
+}
+
+void updateUi(void *data) {
+    struct Userdata *userdata = data;
+    if (atomic_load_explicit(&userdata->streamError, memory_order_relaxed) != 0) {
+        eventLoopStop(userdata->loop);
+        return;
+    }
+    tuiFrame(userdata->tui);
+
+    struct Synth *retired = swapReclaim(&userdata->swap);
+    if (retired != NULL) releaseSynth(userdata, retired);
+    scheduleFrames(userdata);
 }
 
 void soundioCallback(struct SoundIoOutStream *outstream, int frame_count_min, int frame_count_max) {
     struct Userdata *callbackData = outstream->userdata;
     struct SoundIoChannelArea *areas;
+    int16_t block[2 * STREAM_BUF_SIZE];
+    int16_t tap[STREAM_BUF_SIZE];
 
     int framesLeft = frame_count_max;
     int err;
 
+    // the first callback faults the stack in and plays silence, so no rendered
+    // block pays for the faults or reaches the device late
+    bool isWarmup = !atomic_load_explicit(&callbackData->hasAudioThread, memory_order_relaxed);
+    if (isWarmup) {
+        rtschedPrefaultStack();
+        callbackData->audioThread = pthread_self();
+        atomic_store_explicit(&callbackData->hasAudioThread, true, memory_order_release);
+    }
+
+    rtEnter();
     while (framesLeft > 0) {
         int frameCount = framesLeft;
 
         if ((err = soundio_outstream_begin_write(outstream, &areas, &frameCount))) {
-            fprintf(stderr, "%s\n", soundio_strerror(err));
-            exit(1);
+            atomic_store_explicit(&callbackData->streamError, err, memory_order_relaxed);
+            break;
         }
         
         if (!frameCount) break;
 
-        for (int frame = 0; frame < frameCount; frame++) {
-            synthRun(callbackData->synth);
-            int16_t sample = *callbackData->synth->outPtr;
+        for (int frame = 0; frame < frameCount; frame += STREAM_BUF_SIZE) {
+            int blockLen = frameCount - frame < STREAM_BUF_SIZE ? frameCount - frame : STREAM_BUF_SIZE;
+            if (isWarmup) memset(block, 0, 2 * blockLen * sizeof(int16_t));
+            else swapRunBlock(&callbackData->swap, block, blockLen);
+            outputWriteBlock(outstream, areas, frame, block, 2, blockLen);
 
-            for (int channel = 0; channel < outstream->layout.channel_count; channel++) {
-                int16_t *samplePtr = (int16_t *)(areas[channel].ptr + areas[channel].step * frame);
-                *samplePtr = sample;
+            // the scope and spectrum watch the mid signal
+            for (int i = 0; i < blockLen; i++) {
+                tap[i] = (block[2 * i] + block[2 * i + 1]) / 2;
             }
+            ringWrite(&callbackData->outputTap, tap, blockLen);
         }
 
         if ((err = soundio_outstream_end_write(outstream))) {
-            fprintf(stderr, "%s\n", soundio_strerror(err));
-            exit(1);
+            atomic_store_explicit(&callbackData->streamError, err, memory_order_relaxed);
+            break;
         }
 
         framesLeft -= frameCount;
     }
+    rtLeave();
+}
+
+// waits for the first callback, then raises and pins its thread and the render
+// workers. runs on the main thread so the callback never makes these calls
+void applyRealtime(struct Userdata *userdata, struct RtSched *rt) {
+    struct timespec pause = { .tv_nsec = 1000000 };
+    for (int i = 0; i < 2000 && !atomic_load_explicit(&userdata->hasAudioThread, memory_order_acquire); i++) {
+        nanosleep(&pause, NULL);
+    }
+    if (atomic_load_explicit(&userdata->hasAudioThread, memory_order_acquire)) {
+        rtschedApply(rt, userdata->audioThread, "audio", 0);
+    } else {
+        rtschedFallback(rt, "  audio: no callback within 2 s, its thread was left alone\n");
+    }
 
+    pthread_t workers[POOL_MAX_WORKERS];
+    size_t workersLen = poolThreads(workers);
+    for (size_t i = 0; i < workersLen; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "worker %zu", i + 1);
+        rtschedApply(rt, workers[i], name, i + 1);
+    }
 }
 
-int main(void) {
-    system("clear");
-    srandqd(42);
+void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-f fps] [-r priority] [-a cpus] [-l frames] [-s name=file.wav]... [-w name=table.wav]... [patch]\n"
+            "       %s -c out.bin patch\n"
+            "       %s -b matrix -o outdir [-j threads] [-s name=file.wav]... [-w name=table.wav]... patch\n",
+            name, name, name);
+    fprintf(stderr,
+            "  -f  redraw rate of the scope and spectrum, 30 by default\n"
+            "  -r  run the audio thread and render workers SCHED_FIFO at priority\n"
+            "  -a  pin them to cpus, e.g. 2,3 or 2-5, the audio thread to the first\n"
+            "      either of -r and -a also locks memory\n"
+            "  -l  device buffer in frames, e.g. 64\n");
+}
 
-    termInit();
+// a whole number from min to max, what names it when it doesn't parse
+int parseInt(const char *arg, const char *what, long min, long max, int *out) {
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0 || value < min || value > max) {
+        fprintf(stderr, "bad %s %s, takes %ld to %ld\n", what, arg, min, max);
+        return -1;
+    }
+    *out = (int) value;
+    return 0;
+}
+
+// -s name=file.wav maps a sample that patches can play as @name
+int addSample(struct Userdata *userdata, char *arg) {
+    char *path = strchr(arg, '=');
+    if (path == NULL || path == arg || userdata->samplesLen == SAMPLER_MAX_FILES) {
+        fprintf(stderr, "bad sample %s\n", arg);
+        return -1;
+    }
+    *path++ = '\0';
+
+    if (sampleOpen(&userdata->samples[userdata->samplesLen], path) != 0) return -1;
+    userdata->sampleNames[userdata->samplesLen++] = arg;
+    return 0;
+}
 
+// -w name=table.wav loads a wavetable bank that patches can play as @name
+int addWavetable(struct Userdata *userdata, char *arg) {
+    char *path = strchr(arg, '=');
+    if (path == NULL || path == arg || userdata->banksLen == WAVETABLE_MAX_BANKS) {
+        fprintf(stderr, "bad wavetable %s\n", arg);
+        return -1;
+    }
+    *path++ = '\0';
+
+    struct WavetableBank *bank = wavetableAcquire(path);
+    if (bank == NULL) return -1;
+    userdata->banks[userdata->banksLen] = bank;
+    userdata->bankNames[userdata->banksLen++] = arg;
+    return 0;
+}
+
+int main(int argc, char **argv) {
     struct Userdata callbackData = {0};
+    const char *compileOut = NULL;
+    const char *batchMatrix = NULL;
+    const char *batchOut = NULL;
+    int batchThreads = 0;
+    struct RtSched rt = {0};
+    int bufferFrames = 0;
+    int fps = TUI_DEFAULT_FPS;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:c:f:j:l:o:r:s:w:h")) != -1) {
+        switch (opt) {
+        case 'a':
+            if (rtschedParseCpus(&rt, optarg) != 0) return 1;
+            break;
+        case 'b':
+            batchMatrix = optarg;
+            break;
+        case 'c':
+            compileOut = optarg;
+            break;
+        case 'f':
+            if (parseInt(optarg, "frame rate", 1, 1000, &fps) != 0) return 1;
+            break;
+        case 'j':
+            if (parseInt(optarg, "thread count", 1, BATCH_MAX_THREADS, &batchThreads) != 0) return 1;
+            break;
+        case 'l':
+            if (parseInt(optarg, "buffer size", 1, BUFFER_MAX_FRAMES, &bufferFrames) != 0) return 1;
+            break;
+        case 'o':
+            batchOut = optarg;
+            break;
+        case 'r':
+            if (rtschedParsePriority(&rt, optarg) != 0) return 1;
+            break;
+        case 's':
+            if (addSample(&callbackData, optarg) != 0) return 1;
+            break;
+        case 'w':
+            if (addWavetable(&callbackData, optarg) != 0) return 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    const char *patchPath = optind < argc ? argv[optind] : NULL;
 
-    struct SynthModule modules[] = {
-        [0] = MODULE(Oscillator,
-            .freqSample = &callbackData.inputFreq,
-            .waveform = PTR(WAV_Square),
-            .amt = PTR(floatToAmt(0.25)),
-        ),
-        [1] = MODULE(Oscillator,
-            .freqSample = &callbackData.inputFreq,
-            .waveform = PTR(WAV_Saw),
-            .amt = &modules[4].out,
-        ),
-        [2] = MODULE(Mixer,
-            .samplesIn = NULL_TERM_ARR(int16_t*, &modules[0].out, &modules[1].out),
-        ),
-        [3] = MODULE(Filter,
-            .sampleIn = &modules[2].out,
-            .cutoff = &modules[4].out,
-            .impulseLen = 128,
-            .window = WINDOW_Blackman,
-        ),
-        [4] = MODULE(EnvelopeAdsr,
-            .gate = &callbackData.gate,
-            .attackMs = PTRF(500),
-            .decayMs = PTRF(500),
-            .sustain = PTRF(floatToAmt(0.2)),
-            .releaseMs = PTRF(2000),
-            .easing = PTRF(0.8)
-        )
-    };
+    if (compileOut != NULL) {
+        if (patchPath == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        return patchCompileFile(patchPath, compileOut) == 0 ? 0 : 1;
+    }
 
-    struct Synth synth = {
-        .modules = modules,
-        .modulesLen = sizeof(modules) / sizeof(modules[0]),
-        .outPtr = &modules[1].out
-    };
+    // renders a whole library headless, no audio device needed
+    if (batchMatrix != NULL) {
+        struct BatchMatrix matrix;
+        if (patchPath == NULL || batchOut == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (batchLoadMatrix(&matrix, batchMatrix) != 0) return 1;
 
-    callbackData.synth = &synth;
+        srandqd(42);
+        struct PatchInput shared[SAMPLER_MAX_FILES + WAVETABLE_MAX_BANKS];
+        size_t sharedLen = sharedInputs(&callbackData, shared);
+        return batchRender(patchPath, &matrix, shared, sharedLen, batchOut, batchThreads) == 0 ? 0 : 1;
+    }
+
+    srandqd(42);
 
+    callbackData.patchPath = patchPath;
+    callbackData.velocity = INT16_MAX;
+    ringInit(&callbackData.outputTap);
+
+    // a patch file replaces the built-in patch
+    struct Synth synth = {0};
+    if (patchPath != NULL ? loadPatch(&callbackData, &synth) != 0 : buildDefaultPatch(&callbackData, &synth) != 0) {
+        return 1;
+    }
+
+    callbackData.mainSynth = &synth;
+
+    if (prefetcherStart(&callbackData.prefetcher, callbackData.samples, callbackData.samplesLen) != 0) {
+        fprintf(stderr, "unable to start sample prefetcher\n");
+        return 1;
+    }
+
+    termInit();
 
 
     int err;
@@ -156,11 +452,22 @@ int main(void) {
     }
 
     struct SoundIoOutStream *outstream = soundio_outstream_create(device);
-    outstream->format = SoundIoFormatS16NE;
-    outstream->sample_rate = SAMPLE_RATE;
+    if (soundio_device_supports_format(device, SoundIoFormatS16NE)) {
+        outstream->format = SoundIoFormatS16NE;
+    } else if (soundio_device_supports_format(device, SoundIoFormatFloat32NE)) {
+        outstream->format = SoundIoFormatFloat32NE;
+    } else {
+        fprintf(stderr, "no supported sample format\n");
+        return 1;
+    }
+    if (device->sample_rate_current > 0) {
+        outstream->sample_rate = device->sample_rate_current;
+    } else {
+        outstream->sample_rate = soundio_device_nearest_sample_rate(device, DEFAULT_SAMPLE_RATE);
+    }
     outstream->write_callback = soundioCallback;
     outstream->userdata = &callbackData;
-    outstream->software_latency = 0.02;
+    outstream->software_latency = bufferFrames > 0 ? (double) bufferFrames / outstream->sample_rate : 0.02;
 
     if ((err = soundio_outstream_open(outstream))) {
         fprintf(stderr, "unable to open device: %s", soundio_strerror(err));
@@ -170,17 +477,55 @@ int main(void) {
     if (outstream->layout_error)
         fprintf(stderr, "unable to set channel layout: %s\n", soundio_strerror(outstream->layout_error));
 
+    synth.sampleRate = outstream->sample_rate;
+    if (synthInit(&synth) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    callbackData.sampleRate = outstream->sample_rate;
+    swapInit(&callbackData.swap, &synth);
+
+    // the workers start first so locking covers their stacks too
+    bool isRealtime = rt.priority > 0 || rt.cpusLen > 0;
+    if (isRealtime) poolWorkers();
+    if (isRealtime) rtschedLockMemory(&rt);
+
     if ((err = soundio_outstream_start(outstream))) {
         fprintf(stderr, "unable to start device: %s", soundio_strerror(err));
         return 1;
     }
+    if (isRealtime) applyRealtime(&callbackData, &rt);
+
+
 
 
+    struct Tui tui;
+    tuiInit(&tui, "syntheCLIzer");
 
+    struct Spectrum spectrum;
+    tuiAddSpectrum(&tui, &spectrum, &callbackData.outputTap, 1, 1, 66, 18, 2048, WINDOW_Hann, outstream->sample_rate, 50);
 
-    while (callbackData.quit != true) {
-        updateInput(&callbackData);
+    struct Scope scope;
+    double scopeTrigger = 0;
+    tuiAddScope(&tui, &scope, &callbackData.outputTap, 1, 19, 66, 12, 4, &scopeTrigger, TRIG_RISING_EDGE, 33);
+
+    // input, ui frames and wakeups from other threads all dispatch from here
+    struct EventLoop loop;
+    callbackData.frameMs = 1000 / fps;
+    if (eventLoopInit(&loop, callbackData.frameMs) != 0) {
+        fprintf(stderr, "unable to create event loop\n");
+        return 1;
     }
+    loop.onKey = updateInput;
+    loop.onTick = updateUi;
+    loop.userdata = &callbackData;
+    callbackData.tui = &tui;
+    callbackData.loop = &loop;
+
+    eventLoopRun(&loop);
+
+    eventLoopDestroy(&loop);
+    tuiFreeSpectrum(&spectrum);
     
 
 
@@ -188,7 +533,27 @@ int main(void) {
     soundio_device_unref(device);
     soundio_destroy(soundio);
 
+    struct Synth *held[SWAP_MAX_SYNTHS];
+    size_t heldLen = swapClose(&callbackData.swap, held);
+    for (size_t i = 0; i < heldLen; i++) {
+        releaseSynth(&callbackData, held[i]);
+    }
+
+    prefetcherStop(&callbackData.prefetcher);
+    for (size_t i = 0; i < callbackData.samplesLen; i++) {
+        sampleClose(&callbackData.samples[i]);
+    }
+    for (size_t i = 0; i < callbackData.banksLen; i++) {
+        wavetableRelease(callbackData.banks[i]);
+    }
+
     resetTerm();
+    rtschedReport(&rt, stderr);
 
+    int streamError = atomic_load(&callbackData.streamError);
+    if (streamError != 0) {
+        fprintf(stderr, "%s\n", soundio_strerror(streamError));
+        return 1;
+    }
     return 0;
 }
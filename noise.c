@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "noise.h"
+
+#define NOISE_STEP_SAMPLES (NOISE_LANES * 2)
+
+// splitmix32 finaliser, spreads neighbouring seeds over unrelated lane states
+static uint32_t mixSeed(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+void noiseSeed(struct NoiseGen *gen, uint32_t seed) {
+    for (size_t lane = 0; lane < NOISE_LANES; lane++) {
+        uint32_t state = mixSeed(seed + 0x9e3779b9u * (lane + 1));
+        // xorshift never leaves an all zero state
+        gen->lanes[lane] = state != 0 ? state : 0x6d2b79f5u;
+    }
+    gen->bufIdx = NOISE_BUF_SIZE;
+}
+
+static void noiseStep(uint32_t *lanes) {
+    for (size_t lane = 0; lane < NOISE_LANES; lane++) {
+        uint32_t x = lanes[lane];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        lanes[lane] = x;
+    }
+}
+
+void noiseFill(struct NoiseGen *gen, int16_t *out, size_t len) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    __m128i x = _mm_loadu_si128((const __m128i *) gen->lanes);
+    for (; i + NOISE_STEP_SAMPLES <= len; i += NOISE_STEP_SAMPLES) {
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        _mm_storeu_si128((__m128i *) (out + i), x);
+    }
+    _mm_storeu_si128((__m128i *) gen->lanes, x);
+#else
+    for (; i + NOISE_STEP_SAMPLES <= len; i += NOISE_STEP_SAMPLES) {
+        noiseStep(gen->lanes);
+        memcpy(out + i, gen->lanes, sizeof(gen->lanes));
+    }
+#endif
+
+    // a partial step still advances every lane so both paths stay in sync
+    if (i < len) {
+        noiseStep(gen->lanes);
+        memcpy(out + i, gen->lanes, (len - i) * sizeof(int16_t));
+    }
+}
+
+int16_t noiseNext(struct NoiseGen *gen) {
+    if (gen->bufIdx == NOISE_BUF_SIZE) {
+        noiseFill(gen, gen->buf, NOISE_BUF_SIZE);
+        gen->bufIdx = 0;
+    }
+    return gen->buf[gen->bufIdx++];
+}
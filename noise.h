@@ -0,0 +1,23 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NOISE_LANES 4
+#define NOISE_BUF_SIZE 16
+
+// four xorshift32 lanes stepped together, each step yields 8 samples. output
+// depends only on the seed, never on which thread renders or when
+struct NoiseGen {
+    uint32_t lanes[NOISE_LANES];
+    int16_t buf[NOISE_BUF_SIZE];
+    size_t bufIdx;
+};
+
+void noiseSeed(struct NoiseGen *gen, uint32_t seed);
+// block API, fills len full-scale white noise samples
+void noiseFill(struct NoiseGen *gen, int16_t *out, size_t len);
+int16_t noiseNext(struct NoiseGen *gen);
+
+#endif //NOISE_H
@@ -0,0 +1,138 @@
+#include <soundio/soundio.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "output.h"
+#include "dsp.h"
+
+#define S16_TO_F32_SCALE (1.0f / 32768.0f)
+
+static bool areasInterleaved(const struct SoundIoChannelArea *areas, int channelCount, int bytesPerSample) {
+    for (int channel = 0; channel < channelCount; channel++) {
+        if (areas[channel].step != channelCount * bytesPerSample) return false;
+        if (areas[channel].ptr != areas[0].ptr + channel * bytesPerSample) return false;
+    }
+    return true;
+}
+
+#ifdef __SSE2__
+static __m128 s16LoToF32(__m128i in, __m128 scale) {
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16)), scale);
+}
+#endif
+
+static void interleaveS16(const int16_t *block, int blockChannels, int16_t *dst, int channelCount, int frameCount) {
+    int frame = 0;
+
+    if (blockChannels == channelCount) {
+        memcpy(dst, block, sizeof(int16_t) * frameCount * channelCount);
+        return;
+    }
+
+#ifdef __SSE2__
+    if (blockChannels == 1 && channelCount == 2) {
+        for (; frame + 8 <= frameCount; frame += 8) {
+            __m128i mono = _mm_loadu_si128((const __m128i *) (block + frame));
+            _mm_storeu_si128((__m128i *) (dst + 2 * frame), _mm_unpacklo_epi16(mono, mono));
+            _mm_storeu_si128((__m128i *) (dst + 2 * frame + 8), _mm_unpackhi_epi16(mono, mono));
+        }
+    } else if (channelCount % 8 == 0) {
+        for (; frame < frameCount; frame++) {
+            __m128i splat;
+            if (blockChannels == 1) {
+                splat = _mm_set1_epi16(block[frame]);
+            } else {
+                int32_t pair;
+                memcpy(&pair, block + 2 * frame, sizeof(pair));
+                splat = _mm_set1_epi32(pair);
+            }
+            for (int channel = 0; channel < channelCount; channel += 8) {
+                _mm_storeu_si128((__m128i *) (dst + frame * channelCount + channel), splat);
+            }
+        }
+    }
+#endif
+
+    for (; frame < frameCount; frame++) {
+        for (int channel = 0; channel < channelCount; channel++) {
+            dst[frame * channelCount + channel] = block[frame * blockChannels + channel % blockChannels];
+        }
+    }
+}
+
+static void interleaveF32(const int16_t *block, int blockChannels, float *dst, int channelCount, int frameCount) {
+    int frame = 0;
+
+    if (blockChannels == channelCount) {
+        dsp.s16ToF32(block, dst, (size_t) frameCount * channelCount, S16_TO_F32_SCALE);
+        return;
+    }
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(S16_TO_F32_SCALE);
+
+    if (blockChannels == 1 && channelCount == 2) {
+        for (; frame + 4 <= frameCount; frame += 4) {
+            __m128 mono = s16LoToF32(_mm_loadl_epi64((const __m128i *) (block + frame)), scale);
+            _mm_storeu_ps(dst + 2 * frame, _mm_unpacklo_ps(mono, mono));
+            _mm_storeu_ps(dst + 2 * frame + 4, _mm_unpackhi_ps(mono, mono));
+        }
+    } else if (channelCount % 4 == 0) {
+        for (; frame < frameCount; frame++) {
+            float left = block[frame * blockChannels] * S16_TO_F32_SCALE;
+            float right = block[frame * blockChannels + blockChannels - 1] * S16_TO_F32_SCALE;
+            __m128 splat = _mm_setr_ps(left, right, left, right);
+            for (int channel = 0; channel < channelCount; channel += 4) {
+                _mm_storeu_ps(dst + frame * channelCount + channel, splat);
+            }
+        }
+    }
+#endif
+
+    for (; frame < frameCount; frame++) {
+        for (int channel = 0; channel < channelCount; channel++) {
+            dst[frame * channelCount + channel] = block[frame * blockChannels + channel % blockChannels] * S16_TO_F32_SCALE;
+        }
+    }
+}
+
+static void writePlanar(struct SoundIoChannelArea *areas, int frameOffset, const int16_t *block, int blockChannels, int channelCount, int frameCount, bool isFloat) {
+    for (int channel = 0; channel < channelCount; channel++) {
+        char *ptr = areas[channel].ptr + areas[channel].step * frameOffset;
+        int step = areas[channel].step;
+        const int16_t *src = block + channel % blockChannels;
+
+        if (isFloat) {
+            for (int frame = 0; frame < frameCount; frame++, ptr += step) {
+                *(float *) ptr = src[frame * blockChannels] * S16_TO_F32_SCALE;
+            }
+        } else {
+            for (int frame = 0; frame < frameCount; frame++, ptr += step) {
+                *(int16_t *) ptr = src[frame * blockChannels];
+            }
+        }
+    }
+}
+
+void outputWriteBlock(struct SoundIoOutStream *outstream, struct SoundIoChannelArea *areas, int frameOffset, const int16_t *block, int blockChannels, int frameCount) {
+    int channelCount = outstream->layout.channel_count;
+    bool isFloat = outstream->format == SoundIoFormatFloat32NE;
+
+    if (!areasInterleaved(areas, channelCount, outstream->bytes_per_sample)) {
+        writePlanar(areas, frameOffset, block, blockChannels, channelCount, frameCount, isFloat);
+        return;
+    }
+
+    char *dst = areas[0].ptr + areas[0].step * frameOffset;
+    if (isFloat) {
+        interleaveF32(block, blockChannels, (float *) dst, channelCount, frameCount);
+    } else {
+        interleaveS16(block, blockChannels, (int16_t *) dst, channelCount, frameCount);
+    }
+}
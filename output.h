@@ -0,0 +1,12 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <soundio/soundio.h>
+#include <stdint.h>
+
+// writes frameCount frames of a rendered block (blockChannels = 1 for mono,
+// 2 for interleaved stereo) to the stream's channel areas, starting at frameOffset.
+// mono blocks are duplicated to every channel, stereo blocks alternate L/R
+void outputWriteBlock(struct SoundIoOutStream *outstream, struct SoundIoChannelArea *areas, int frameOffset, const int16_t *block, int blockChannels, int frameCount);
+
+#endif //OUTPUT_H
@@ -0,0 +1,700 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "patch.h"
+
+#define PATCH_MAX_MODULES 256
+#define PATCH_MAX_INPUTS 32
+#define PATCH_MAX_BINDINGS 32
+#define PATCH_LINE_SIZE 256
+#define PATCH_MAX_TOKENS 40
+
+// binary layout: header, input names, then per module a record followed by
+// its bindings; everything is native endian and read with memcpy
+struct PatchHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t modulesLen;
+    uint16_t inputsLen;
+    uint16_t outModule;
+    uint32_t bindingsLen;
+};
+
+struct PatchModuleRec {
+    uint16_t tag;
+    uint16_t bindingsLen;
+};
+
+enum BindingKind {
+    BIND_Const,
+    BIND_Module,
+    BIND_Input,
+};
+
+struct PatchBinding {
+    uint8_t kind;
+    uint8_t port;
+    uint16_t reserved;
+    uint32_t value;
+};
+
+// constants live in the arena next to the module that reads them
+union PatchSlot {
+    int16_t sample;
+    float f;
+    bool gate;
+};
+
+static const char *waveformNames[] = { "Sine", "Square", "Tri", "Saw", "Noise" };
+static const char *noiseColorNames[] = { "White", "Pink", "Band" };
+static const char *windowNames[] = { "Rectangular", "Hamming", "Hann", "Bartlett", "Blackman" };
+
+#define ARR_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+
+static int loadError(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "patch: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    return -1;
+}
+
+static size_t layoutPush(size_t used, size_t size, size_t align) {
+    return arenaAlignUp(used, align) + size;
+}
+
+static enum PortKind elementKind(enum PortKind kind) {
+    return kind == PORT_SampleList ? PORT_Sample : kind;
+}
+
+// ports that only the host can fill, with something it loaded itself
+static bool isHostResource(enum PortKind kind) {
+    return kind == PORT_SampleData || kind == PORT_Wavetable;
+}
+
+// ports stored in the module body itself rather than pointed at
+static bool isByValue(enum PortKind kind) {
+    return kind == PORT_Size || kind == PORT_Window || kind == PORT_Seed;
+}
+
+static int validateBinding(const struct ModuleInfo *info, const struct PatchBinding *binding,
+                           uint16_t modulesLen, const enum PortKind *inputKinds, uint16_t inputsLen) {
+    if (binding->port >= info->portsLen) return loadError("%s has no port %u", info->name, binding->port);
+
+    const struct ModulePort *port = &info->ports[binding->port];
+    enum PortKind kind = elementKind(port->kind);
+
+    switch (binding->kind) {
+    case BIND_Const:
+        if (port->kind == PORT_SampleList || isHostResource(kind))
+            return loadError("%s.%s only takes references", info->name, port->name);
+        if (kind == PORT_Size && (binding->value == 0 || binding->value > port->maxValue))
+            return loadError("%s.%s out of range", info->name, port->name);
+        if (kind == PORT_Window && binding->value >= ARR_LEN(windowNames))
+            return loadError("%s.%s unknown window", info->name, port->name);
+        if (kind == PORT_Gate && binding->value > 1) return loadError("%s.%s not a gate value", info->name, port->name);
+        if (kind == PORT_Float) {
+            float f;
+            memcpy(&f, &binding->value, sizeof(f));
+            if (!isfinite(f)) return loadError("%s.%s not finite", info->name, port->name);
+        }
+        return 0;
+    case BIND_Module:
+        if (binding->value >= modulesLen) return loadError("%s.%s refers to a missing module", info->name, port->name);
+        if (kind != PORT_Sample) return loadError("%s.%s can't take a module output", info->name, port->name);
+        return 0;
+    case BIND_Input:
+        if (binding->value >= inputsLen) return loadError("%s.%s refers to a missing input", info->name, port->name);
+        if (inputKinds[binding->value] != kind) return loadError("%s.%s input kind mismatch", info->name, port->name);
+        return 0;
+    default:
+        return loadError("%s.%s bad binding", info->name, port->name);
+    }
+}
+
+// walks the module records once to check them and to size the arena exactly
+// as the build pass will lay it out
+static int validatePatch(const char *bin, size_t binLen, size_t pos, const struct PatchHeader *header,
+                         const enum PortKind *inputKinds, size_t *arenaSize) {
+    size_t used = layoutPush(0, header->modulesLen * sizeof(struct SynthModule), ARENA_ALIGN);
+    uint32_t bindingsTotal = 0;
+
+    for (uint16_t i = 0; i < header->modulesLen; i++) {
+        struct PatchModuleRec rec;
+        if (binLen - pos < sizeof(rec)) return loadError("truncated module %u", i);
+        memcpy(&rec, bin + pos, sizeof(rec));
+        pos += sizeof(rec);
+
+        const struct ModuleInfo *info = synthModuleInfo(rec.tag);
+        if (info == NULL) return loadError("module %u has unknown type %u", i, rec.tag);
+        if ((binLen - pos) / sizeof(struct PatchBinding) < rec.bindingsLen) return loadError("truncated module %u", i);
+
+        used = layoutPush(used, info->size, ARENA_ALIGN);
+
+        uint32_t bound = 0;
+        size_t listLen = 0;
+        for (uint16_t b = 0; b < rec.bindingsLen; b++) {
+            struct PatchBinding binding;
+            memcpy(&binding, bin + pos, sizeof(binding));
+            pos += sizeof(binding);
+
+            if (validateBinding(info, &binding, header->modulesLen, inputKinds, header->inputsLen)) return -1;
+
+            const struct ModulePort *port = &info->ports[binding.port];
+            if (port->kind == PORT_SampleList) {
+                listLen++;
+            } else if (bound & (1u << binding.port)) {
+                return loadError("%s.%s bound twice", info->name, port->name);
+            }
+            bound |= 1u << binding.port;
+
+            if (binding.kind == BIND_Const && !isByValue(port->kind)) {
+                used = layoutPush(used, sizeof(union PatchSlot), _Alignof(union PatchSlot));
+            }
+        }
+
+        for (size_t p = 0; p < info->portsLen; p++) {
+            if (!info->ports[p].isOptional && !(bound & (1u << p)))
+                return loadError("%s.%s not connected", info->name, info->ports[p].name);
+        }
+
+        if (listLen > 0) used = layoutPush(used, (listLen + 1) * sizeof(int16_t*), _Alignof(int16_t*));
+        bindingsTotal += rec.bindingsLen;
+    }
+
+    if (pos != binLen) return loadError("trailing data");
+    if (bindingsTotal != header->bindingsLen) return loadError("binding count mismatch");
+
+    *arenaSize = used;
+    return 0;
+}
+
+static void buildModule(struct Arena *arena, struct SynthModule *modules, struct SynthModule *module,
+                        const struct ModuleInfo *info, const struct PatchBinding *bindings, uint16_t bindingsLen,
+                        void *const *inputPtrs) {
+    char *body = arenaAlloc(arena, info->size, ARENA_ALIGN);
+    module->ptr = body;
+
+    size_t listLen = 0;
+    for (uint16_t b = 0; b < bindingsLen; b++) {
+        struct PatchBinding binding;
+        memcpy(&binding, &bindings[b], sizeof(binding));
+        const struct ModulePort *port = &info->ports[binding.port];
+
+        void *target;
+        switch (binding.kind) {
+        case BIND_Module:
+            target = &modules[binding.value].out;
+            break;
+        case BIND_Input:
+            target = inputPtrs[binding.value];
+            break;
+        default:
+            target = NULL;
+            break;
+        }
+
+        switch (port->kind) {
+        case PORT_Size:
+            *(size_t*) (body + port->offset) = binding.value;
+            continue;
+        case PORT_Window:
+            *(enum FirWindowType*) (body + port->offset) = binding.value;
+            continue;
+        case PORT_Seed:
+            *(uint32_t*) (body + port->offset) = binding.value;
+            continue;
+        case PORT_SampleList:
+            listLen++;
+            continue;
+        default:
+            break;
+        }
+
+        if (binding.kind == BIND_Const) {
+            union PatchSlot *slot = arenaAlloc(arena, sizeof(*slot), _Alignof(union PatchSlot));
+            if (port->kind == PORT_Sample) slot->sample = (int16_t) binding.value;
+            else if (port->kind == PORT_Gate) slot->gate = binding.value != 0;
+            else memcpy(&slot->f, &binding.value, sizeof(slot->f));
+            target = slot;
+        }
+        *(void**) (body + port->offset) = target;
+    }
+
+    if (listLen == 0) return;
+
+    // lists are NULL terminated pointer arrays, filled in binding order
+    int16_t **list = arenaAlloc(arena, (listLen + 1) * sizeof(int16_t*), _Alignof(int16_t*));
+    size_t listIdx = 0;
+    for (uint16_t b = 0; b < bindingsLen; b++) {
+        struct PatchBinding binding;
+        memcpy(&binding, &bindings[b], sizeof(binding));
+        const struct ModulePort *port = &info->ports[binding.port];
+        if (port->kind != PORT_SampleList) continue;
+
+        list[listIdx++] = binding.kind == BIND_Module ? &modules[binding.value].out : inputPtrs[binding.value];
+        *(int16_t***) (body + port->offset) = list;
+    }
+    list[listIdx] = NULL;
+}
+
+int patchLoad(struct Synth *synth, const void *data, size_t binLen,
+              const struct PatchInput *inputs, size_t inputsLen) {
+    const char *bin = data;
+    struct PatchHeader header;
+
+    if (binLen < sizeof(header)) return loadError("truncated header");
+    memcpy(&header, bin, sizeof(header));
+    if (memcmp(header.magic, PATCH_MAGIC, sizeof(header.magic)) != 0) return loadError("bad magic");
+    if (header.version != PATCH_VERSION) return loadError("unsupported version %u", header.version);
+    if (header.modulesLen == 0 || header.outModule >= header.modulesLen) return loadError("bad module count");
+    if (header.inputsLen > PATCH_MAX_INPUTS) return loadError("too many inputs");
+
+    size_t pos = sizeof(header);
+    if (binLen - pos < (size_t) header.inputsLen * PATCH_NAME_LEN) return loadError("truncated inputs");
+
+    // patches name host inputs, the host hands over their addresses
+    enum PortKind inputKinds[PATCH_MAX_INPUTS];
+    void *inputPtrs[PATCH_MAX_INPUTS];
+    for (uint16_t i = 0; i < header.inputsLen; i++, pos += PATCH_NAME_LEN) {
+        const char *name = bin + pos;
+        if (memchr(name, '\0', PATCH_NAME_LEN) == NULL) return loadError("bad input name");
+
+        size_t j = 0;
+        while (j < inputsLen && strcmp(inputs[j].name, name) != 0) j++;
+        if (j == inputsLen) return loadError("host has no input @%s", name);
+        inputKinds[i] = inputs[j].kind;
+        inputPtrs[i] = inputs[j].ptr;
+    }
+
+    size_t arenaSize = 0;
+    if (validatePatch(bin, binLen, pos, &header, inputKinds, &arenaSize)) return -1;
+
+    struct Arena arena;
+    if (arenaInit(&arena, arenaSize)) return loadError("out of memory");
+
+    struct SynthModule *modules = arenaAlloc(&arena, header.modulesLen * sizeof(*modules), ARENA_ALIGN);
+    for (uint16_t i = 0; i < header.modulesLen; i++) {
+        struct PatchModuleRec rec;
+        memcpy(&rec, bin + pos, sizeof(rec));
+        pos += sizeof(rec);
+
+        modules[i].tag = rec.tag;
+        buildModule(&arena, modules, &modules[i], synthModuleInfo(rec.tag),
+                    (const struct PatchBinding*) (bin + pos), rec.bindingsLen, inputPtrs);
+        pos += rec.bindingsLen * sizeof(struct PatchBinding);
+    }
+
+    arenaFree(&synth->arena);
+    synth->arena = arena;
+    synth->modules = modules;
+    synth->modulesLen = header.modulesLen;
+    synth->_priv.modulesCap = header.modulesLen;
+    synth->_priv.isInit = false;
+    return synthSetOut(synth, header.outModule);
+}
+
+
+struct CompiledModule {
+    char name[PATCH_NAME_LEN];
+    struct PatchModuleRec rec;
+    struct PatchBinding bindings[PATCH_MAX_BINDINGS];
+};
+
+struct Compiler {
+    struct CompiledModule modules[PATCH_MAX_MODULES];
+    size_t modulesLen;
+    char inputNames[PATCH_MAX_INPUTS][PATCH_NAME_LEN];
+    enum PortKind inputKinds[PATCH_MAX_INPUTS];
+    size_t inputsLen;
+    int outModule;
+    size_t line;
+};
+
+static int compileError(const struct Compiler *compiler, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "patch:%zu: ", compiler->line);
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    return -1;
+}
+
+// splits on whitespace with '=' as a token of its own, '#' starts a comment
+static size_t tokenize(char *line, char **tokens) {
+    size_t len = 0;
+    char *c = line;
+    while (*c != '\0' && *c != '#' && len < PATCH_MAX_TOKENS) {
+        if (isspace((unsigned char) *c)) {
+            *c++ = '\0';
+        } else if (*c == '=') {
+            tokens[len++] = "=";
+            *c++ = '\0';
+        } else {
+            tokens[len++] = c;
+            while (*c != '\0' && *c != '#' && *c != '=' && !isspace((unsigned char) *c)) c++;
+        }
+    }
+    *c = '\0';
+    return len;
+}
+
+static int findName(const char **names, size_t len, const char *name) {
+    for (size_t i = 0; i < len; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static int findModule(const struct Compiler *compiler, const char *name) {
+    for (size_t i = 0; i < compiler->modulesLen; i++) {
+        if (strcmp(compiler->modules[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static bool parseFloat(const char *tok, float *out) {
+    char *end;
+    *out = strtof(tok, &end);
+    return end != tok && *end == '\0' && isfinite(*out);
+}
+
+// plain numbers, or amt(x) and freq(x) converted to the engine's sample scale
+static bool parseNumber(const char *tok, float *out) {
+    char inner[PATCH_LINE_SIZE];
+    size_t len = strlen(tok);
+    if (len == 0 || tok[len - 1] != ')') return parseFloat(tok, out);
+
+    const char *open = strchr(tok, '(');
+    if (open == NULL || (size_t) (tok + len - 1 - open) >= sizeof(inner)) return false;
+    memcpy(inner, open + 1, tok + len - 2 - open);
+    inner[tok + len - 2 - open] = '\0';
+
+    float x;
+    if (!parseFloat(inner, &x)) return false;
+    if (open - tok == 3 && strncmp(tok, "amt", 3) == 0) *out = floatToAmt(x);
+    else if (open - tok == 4 && strncmp(tok, "freq", 4) == 0 && x > 0) *out = freqToSample(x);
+    else return false;
+    return true;
+}
+
+static int compileInput(struct Compiler *compiler, const char *name, enum PortKind kind, uint32_t *value) {
+    if (strlen(name) >= PATCH_NAME_LEN || *name == '\0') return compileError(compiler, "bad input name @%s", name);
+
+    size_t i = 0;
+    while (i < compiler->inputsLen && strcmp(compiler->inputNames[i], name) != 0) i++;
+    if (i == compiler->inputsLen) {
+        if (i == PATCH_MAX_INPUTS) return compileError(compiler, "too many inputs");
+        strcpy(compiler->inputNames[i], name);
+        compiler->inputKinds[i] = kind;
+        compiler->inputsLen++;
+    } else if (compiler->inputKinds[i] != kind) {
+        return compileError(compiler, "@%s used as two different kinds", name);
+    }
+    *value = i;
+    return 0;
+}
+
+static int compileValue(struct Compiler *compiler, const struct ModulePort *port, const char *tok,
+                        struct PatchBinding *binding) {
+    enum PortKind kind = elementKind(port->kind);
+    binding->kind = BIND_Const;
+
+    if (tok[0] == '@') {
+        if (isByValue(kind)) return compileError(compiler, "%s can't take an input", port->name);
+        binding->kind = BIND_Input;
+        return compileInput(compiler, tok + 1, kind, &binding->value);
+    }
+
+    int idx;
+    float f;
+    switch (kind) {
+    case PORT_Sample:
+        if ((idx = findModule(compiler, tok)) >= 0) {
+            binding->kind = BIND_Module;
+            binding->value = idx;
+            return 0;
+        }
+        if (port->kind == PORT_SampleList) return compileError(compiler, "%s: no module %s", port->name, tok);
+        if ((idx = findName(waveformNames, ARR_LEN(waveformNames), tok)) >= 0
+            || (idx = findName(noiseColorNames, ARR_LEN(noiseColorNames), tok)) >= 0) {
+            binding->value = (uint16_t) idx;
+            return 0;
+        }
+        if (!parseNumber(tok, &f) || f < INT16_MIN || f > INT16_MAX)
+            return compileError(compiler, "%s: bad sample value %s", port->name, tok);
+        binding->value = (uint16_t) (int16_t) lrintf(f);
+        return 0;
+    case PORT_Float:
+        if (!parseNumber(tok, &f)) return compileError(compiler, "%s: bad number %s", port->name, tok);
+        memcpy(&binding->value, &f, sizeof(f));
+        return 0;
+    case PORT_Gate:
+        if (strcmp(tok, "on") == 0 || strcmp(tok, "true") == 0 || strcmp(tok, "1") == 0) binding->value = 1;
+        else if (strcmp(tok, "off") == 0 || strcmp(tok, "false") == 0 || strcmp(tok, "0") == 0) binding->value = 0;
+        else return compileError(compiler, "%s: bad gate value %s", port->name, tok);
+        return 0;
+    case PORT_Size:
+        if (!parseFloat(tok, &f) || f < 1 || f > port->maxValue || f != floorf(f))
+            return compileError(compiler, "%s: must be 1..%u", port->name, port->maxValue);
+        binding->value = f;
+        return 0;
+    case PORT_Seed: {
+        char *end;
+        unsigned long seed = strtoul(tok, &end, 0);
+        if (end == tok || *end != '\0' || seed > UINT32_MAX) return compileError(compiler, "%s: bad seed %s", port->name, tok);
+        binding->value = seed;
+        return 0;
+    }
+    case PORT_Window:
+        if ((idx = findName(windowNames, ARR_LEN(windowNames), tok)) < 0)
+            return compileError(compiler, "%s: unknown window %s", port->name, tok);
+        binding->value = idx;
+        return 0;
+    case PORT_SampleData:
+    case PORT_Wavetable:
+        // files are opened by the host and handed over as inputs
+        return compileError(compiler, "%s takes a host resource as @name", port->name);
+    default:
+        return compileError(compiler, "%s: unsupported port", port->name);
+    }
+}
+
+static int compileLine(struct Compiler *compiler, char **tokens, size_t len, int *current) {
+    if (strcmp(tokens[0], "module") == 0) {
+        (*current)++;
+        return 0;
+    }
+    if (strcmp(tokens[0], "out") == 0) {
+        if (len != 2 || (compiler->outModule = findModule(compiler, tokens[1])) < 0)
+            return compileError(compiler, "out takes one module name");
+        return 0;
+    }
+    if (*current < 0) return compileError(compiler, "port outside of a module");
+    if (len < 3 || strcmp(tokens[1], "=") != 0) return compileError(compiler, "expected <port> = <value>");
+
+    struct CompiledModule *module = &compiler->modules[*current];
+    const struct ModuleInfo *info = synthModuleInfo(module->rec.tag);
+
+    size_t p = 0;
+    while (p < info->portsLen && strcmp(info->ports[p].name, tokens[0]) != 0) p++;
+    if (p == info->portsLen) return compileError(compiler, "%s has no port %s", info->name, tokens[0]);
+    if (info->ports[p].kind != PORT_SampleList && len != 3)
+        return compileError(compiler, "%s takes a single value", tokens[0]);
+
+    for (size_t i = 2; i < len; i++) {
+        if (module->rec.bindingsLen == PATCH_MAX_BINDINGS) return compileError(compiler, "too many bindings");
+        struct PatchBinding *binding = &module->bindings[module->rec.bindingsLen++];
+        binding->port = p;
+        if (compileValue(compiler, &info->ports[p], tokens[i], binding)) return -1;
+    }
+    return 0;
+}
+
+// two passes over the lines: declarations first so connections can name
+// modules declared further down
+static int compilePass(struct Compiler *compiler, const char *text, size_t textLen, bool isDeclPass) {
+    char line[PATCH_LINE_SIZE];
+    char *tokens[PATCH_MAX_TOKENS];
+    int current = -1;
+    size_t pos = 0;
+
+    compiler->line = 0;
+    while (pos < textLen) {
+        const char *end = memchr(text + pos, '\n', textLen - pos);
+        size_t lineLen = (end != NULL ? (size_t) (end - text) : textLen) - pos;
+        compiler->line++;
+
+        if (lineLen >= sizeof(line)) return compileError(compiler, "line too long");
+        memcpy(line, text + pos, lineLen);
+        line[lineLen] = '\0';
+        pos += lineLen + 1;
+
+        size_t len = tokenize(line, tokens);
+        if (len == 0) continue;
+        if (len == PATCH_MAX_TOKENS) return compileError(compiler, "too many values");
+
+        if (!isDeclPass) {
+            if (compileLine(compiler, tokens, len, &current)) return -1;
+            continue;
+        }
+        if (strcmp(tokens[0], "module") != 0) continue;
+
+        if (len != 3) return compileError(compiler, "expected module <name> <Type>");
+        if (compiler->modulesLen == PATCH_MAX_MODULES) return compileError(compiler, "too many modules");
+        if (strlen(tokens[1]) >= PATCH_NAME_LEN) return compileError(compiler, "name %s too long", tokens[1]);
+        if (findModule(compiler, tokens[1]) >= 0) return compileError(compiler, "duplicate module %s", tokens[1]);
+
+        struct CompiledModule *module = &compiler->modules[compiler->modulesLen];
+        size_t tag = 0;
+        while (tag < MODULE_TYPE_COUNT && strcmp(synthModuleInfo(tag)->name, tokens[2]) != 0) tag++;
+        if (tag == MODULE_TYPE_COUNT) return compileError(compiler, "unknown module type %s", tokens[2]);
+
+        strcpy(module->name, tokens[1]);
+        module->rec.tag = tag;
+        compiler->modulesLen++;
+    }
+    return 0;
+}
+
+int patchCompile(const char *text, size_t textLen, void **bin, size_t *binLen) {
+    struct Compiler *compiler = calloc(1, sizeof(*compiler));
+    if (compiler == NULL) return loadError("out of memory");
+    compiler->outModule = -1;
+
+    int err = compilePass(compiler, text, textLen, true);
+    if (!err) err = compilePass(compiler, text, textLen, false);
+    if (!err && compiler->modulesLen == 0) err = loadError("no modules");
+    if (!err && compiler->outModule < 0) err = loadError("no out module");
+
+    size_t size = sizeof(struct PatchHeader) + compiler->inputsLen * PATCH_NAME_LEN;
+    for (size_t i = 0; i < compiler->modulesLen; i++) {
+        size += sizeof(struct PatchModuleRec) + compiler->modules[i].rec.bindingsLen * sizeof(struct PatchBinding);
+    }
+
+    char *out = err ? NULL : calloc(1, size);
+    if (!err && out == NULL) err = loadError("out of memory");
+    if (err) {
+        free(compiler);
+        return -1;
+    }
+
+    struct PatchHeader header = {
+        .version = PATCH_VERSION,
+        .modulesLen = compiler->modulesLen,
+        .inputsLen = compiler->inputsLen,
+        .outModule = compiler->outModule,
+    };
+    memcpy(header.magic, PATCH_MAGIC, sizeof(header.magic));
+
+    size_t pos = sizeof(header);
+    memcpy(out + pos, compiler->inputNames, compiler->inputsLen * PATCH_NAME_LEN);
+    pos += compiler->inputsLen * PATCH_NAME_LEN;
+
+    for (size_t i = 0; i < compiler->modulesLen; i++) {
+        struct CompiledModule *module = &compiler->modules[i];
+        memcpy(out + pos, &module->rec, sizeof(module->rec));
+        pos += sizeof(module->rec);
+        memcpy(out + pos, module->bindings, module->rec.bindingsLen * sizeof(struct PatchBinding));
+        pos += module->rec.bindingsLen * sizeof(struct PatchBinding);
+        header.bindingsLen += module->rec.bindingsLen;
+    }
+    memcpy(out, &header, sizeof(header));
+
+    free(compiler);
+    *bin = out;
+    *binLen = size;
+    return 0;
+}
+
+
+static const char *mapFile(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty or unreadable\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    *len = st.st_size;
+    return data;
+}
+
+static bool isBinary(const char *data, size_t len) {
+    return len >= sizeof(struct PatchHeader) && memcmp(data, PATCH_MAGIC, strlen(PATCH_MAGIC)) == 0;
+}
+
+int patchLoadFile(struct Synth *synth, const char *path,
+                  const struct PatchInput *inputs, size_t inputsLen) {
+    size_t len;
+    const char *data = mapFile(path, &len);
+    if (data == NULL) return -1;
+
+    int err;
+    if (isBinary(data, len)) {
+        err = patchLoad(synth, data, len, inputs, inputsLen);
+    } else {
+        void *bin;
+        size_t binLen;
+        err = patchCompile(data, len, &bin, &binLen);
+        if (!err) {
+            err = patchLoad(synth, bin, binLen, inputs, inputsLen);
+            free(bin);
+        }
+    }
+
+    munmap((void*) data, len);
+    return err;
+}
+
+int patchReadFile(const char *path, void **bin, size_t *binLen) {
+    size_t len;
+    const char *data = mapFile(path, &len);
+    if (data == NULL) return -1;
+
+    int err = 0;
+    if (isBinary(data, len)) {
+        *bin = malloc(len);
+        if (*bin == NULL) err = loadError("out of memory");
+        else memcpy(*bin, data, len);
+        *binLen = len;
+    } else {
+        err = patchCompile(data, len, bin, binLen);
+    }
+
+    munmap((void*) data, len);
+    return err;
+}
+
+int patchCompileFile(const char *inPath, const char *outPath) {
+    size_t len;
+    const char *data = mapFile(inPath, &len);
+    if (data == NULL) return -1;
+
+    void *bin;
+    size_t binLen;
+    int err = isBinary(data, len) ? loadError("%s is already compiled", inPath) : patchCompile(data, len, &bin, &binLen);
+    munmap((void*) data, len);
+    if (err) return -1;
+
+    FILE *out = fopen(outPath, "wb");
+    if (out == NULL) {
+        perror(outPath);
+        free(bin);
+        return -1;
+    }
+    if (fwrite(bin, 1, binLen, out) != binLen) err = loadError("short write to %s", outPath);
+    if (fclose(out) != 0) err = -1;
+
+    free(bin);
+    return err;
+}
@@ -0,0 +1,33 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <stddef.h>
+
+#include "engine.h"
+
+#define PATCH_MAGIC "SCZP"
+#define PATCH_VERSION 1
+#define PATCH_NAME_LEN 16
+
+// a value the host owns and patches refer to as @name, e.g. the note pitch
+struct PatchInput {
+    const char *name;
+    enum PortKind kind;
+    void *ptr;
+};
+
+// text -> compact binary, *bin is malloc'd and owned by the caller
+int patchCompile(const char *text, size_t textLen, void **bin, size_t *binLen);
+// validates a binary patch and builds it into synth->arena; the synth still
+// needs its sampleRate set and synthInit called afterwards
+int patchLoad(struct Synth *synth, const void *bin, size_t binLen,
+              const struct PatchInput *inputs, size_t inputsLen);
+// maps the file and loads it, compiling on the fly when it isn't binary
+int patchLoadFile(struct Synth *synth, const char *path,
+                  const struct PatchInput *inputs, size_t inputsLen);
+// reads a patch file as binary, compiling it when it's text. *bin is malloc'd
+// and owned by the caller, for loading the same patch into many synths
+int patchReadFile(const char *path, void **bin, size_t *binLen);
+int patchCompileFile(const char *inPath, const char *outPath);
+
+#endif //PATCH_H
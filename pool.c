@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "rtsched.h"
+
+// next and job carry the job's generation above this bit and a task index or
+// count below it, so a claim is only ever checked against the job it was
+// made in. tasksLen has to fit below it
+#define POOL_GEN_SHIFT 32
+#define POOL_INDEX_MASK ((UINT64_C(1) << POOL_GEN_SHIFT) - 1)
+
+static struct {
+    pthread_t threads[POOL_MAX_WORKERS];
+    size_t workersLen;
+    sem_t wake;
+
+    atomic_flag isBusy;
+    // the job, written by the caller before it publishes next. only read
+    // through a claim of the same generation that is below tasksLen, and the
+    // job can't finish while such a claim's task is still running
+    void (*run)(void *ctx, size_t task);
+    void *ctx;
+    // generation and tasksLen of the current job
+    atomic_uint_least64_t job;
+    // generation and the next task index to claim
+    atomic_uint_least64_t next;
+    // tasks still running
+    atomic_size_t pending;
+} pool = { .isBusy = ATOMIC_FLAG_INIT };
+
+static pthread_once_t startOnce = PTHREAD_ONCE_INIT;
+
+// claims tasks until none are left, a finished task releases its writes to
+// whoever sees pending drop. a worker that wakes or resumes late holds a claim
+// from a job that has finished, or that the next job has replaced, and stops
+static void poolDrain(void) {
+    for (;;) {
+        uint_least64_t claim = atomic_fetch_add_explicit(&pool.next, 1, memory_order_acq_rel);
+        uint_least64_t job = atomic_load_explicit(&pool.job, memory_order_relaxed);
+        if (claim >> POOL_GEN_SHIFT != job >> POOL_GEN_SHIFT) return;
+        if ((claim & POOL_INDEX_MASK) >= (job & POOL_INDEX_MASK)) return;
+        pool.run(pool.ctx, claim & POOL_INDEX_MASK);
+        atomic_fetch_sub_explicit(&pool.pending, 1, memory_order_release);
+    }
+}
+
+static void *poolWorker(void *arg) {
+    (void) arg;
+    // workers only render, so their first task shouldn't be the one to fault
+    // their stack in
+    rtschedPrefaultStack();
+    for (;;) {
+        while (sem_wait(&pool.wake) != 0) {}
+        poolDrain();
+    }
+    return NULL;
+}
+
+static void poolStart(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t want = cpus > 1 ? (size_t) cpus - 1 : 0;
+
+    const char *forced = getenv("SYNTH_WORKERS");
+    if (forced != NULL && forced[0] != '\0') {
+        char *end;
+        long workers = strtol(forced, &end, 10);
+        if (*end != '\0' || workers < 0 || workers > POOL_MAX_WORKERS) {
+            fprintf(stderr, "pool: bad SYNTH_WORKERS %s, using %zu workers\n", forced, want);
+        } else {
+            want = workers;
+        }
+    }
+    if (want > POOL_MAX_WORKERS) want = POOL_MAX_WORKERS;
+    if (want == 0 || sem_init(&pool.wake, 0, 0) != 0) return;
+
+    for (size_t i = 0; i < want; i++) {
+        if (pthread_create(&pool.threads[i], NULL, poolWorker, NULL) != 0) break;
+        pthread_detach(pool.threads[i]);
+        pool.workersLen++;
+    }
+}
+
+size_t poolWorkers(void) {
+    pthread_once(&startOnce, poolStart);
+    return pool.workersLen;
+}
+
+size_t poolThreads(pthread_t *threads) {
+    size_t workersLen = poolWorkers();
+    for (size_t i = 0; i < workersLen; i++) threads[i] = pool.threads[i];
+    return workersLen;
+}
+
+void poolRun(size_t tasksLen, void (*run)(void *ctx, size_t task), void *ctx) {
+    if (tasksLen == 0) return;
+    if (poolWorkers() == 0 || tasksLen == 1 || atomic_flag_test_and_set_explicit(&pool.isBusy, memory_order_acquire)) {
+        for (size_t task = 0; task < tasksLen; task++) run(ctx, task);
+        return;
+    }
+
+    // job is written before next, so any claim of this generation sees it
+    uint_least64_t gen = (atomic_load_explicit(&pool.job, memory_order_relaxed) >> POOL_GEN_SHIFT) + 1;
+    pool.run = run;
+    pool.ctx = ctx;
+    atomic_store_explicit(&pool.pending, tasksLen, memory_order_relaxed);
+    atomic_store_explicit(&pool.job, gen << POOL_GEN_SHIFT | tasksLen, memory_order_relaxed);
+    atomic_store_explicit(&pool.next, gen << POOL_GEN_SHIFT, memory_order_release);
+
+    size_t helpers = tasksLen - 1 < pool.workersLen ? tasksLen - 1 : pool.workersLen;
+    for (size_t i = 0; i < helpers; i++) sem_post(&pool.wake);
+
+    poolDrain();
+    // the other tasks are about as long as ours, so this wait is short. yielding
+    // keeps it from starving a worker on an oversubscribed host
+    while (atomic_load_explicit(&pool.pending, memory_order_acquire) != 0) sched_yield();
+
+    atomic_flag_clear_explicit(&pool.isBusy, memory_order_release);
+}
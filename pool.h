@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define POOL_MAX_WORKERS 15
+
+// one process wide set of worker threads that a render call lends its tasks
+// to. the threads start on the first poolWorkers call and live as long as the
+// process, sleeping when there's no work
+
+// worker threads running, starting them if this is the first call. one per
+// cpu past the first, or SYNTH_WORKERS of them when that's set, so a one cpu
+// host can still run the scheduled path. 0 when there are none or threads
+// can't be created
+size_t poolWorkers(void);
+// fills threads with up to POOL_MAX_WORKERS worker handles, starting them if
+// needed, so their scheduling can be changed from outside
+size_t poolThreads(pthread_t *threads);
+// runs run(ctx, task) for every task below tasksLen across the workers and the
+// calling thread, returning once all have finished. never blocks on a lock: if
+// another thread is already using the pool the caller runs every task itself
+void poolRun(size_t tasksLen, void (*run)(void *ctx, size_t task), void *ctx);
+
+#endif //POOL_H
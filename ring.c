@@ -0,0 +1,64 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ring.h"
+
+// readers only copy from the newest half of the ring, so a copy is only lost
+// when the producer gets half a ring ahead while it's in progress
+#define RING_READABLE (RING_BUF_SIZE / 2)
+
+void ringInit(struct SampleRing *ring) {
+    atomic_init(&ring->writeIdx, 0);
+    atomic_init(&ring->writeEnd, 0);
+}
+
+void ringWrite(struct SampleRing *ring, const int16_t *samples, size_t len) {
+    size_t writeIdx = atomic_load_explicit(&ring->writeIdx, memory_order_relaxed);
+
+    if (len > RING_BUF_SIZE) {
+        samples += len - RING_BUF_SIZE;
+        writeIdx += len - RING_BUF_SIZE;
+        len = RING_BUF_SIZE;
+    }
+
+    // announced before any sample lands, so a reader that sees the old
+    // samples overwritten also sees the new end
+    atomic_store_explicit(&ring->writeEnd, writeIdx + len, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    size_t start = writeIdx & (RING_BUF_SIZE - 1);
+    size_t firstLen = RING_BUF_SIZE - start < len ? RING_BUF_SIZE - start : len;
+    memcpy(ring->buf + start, samples, firstLen * sizeof(int16_t));
+    memcpy(ring->buf, samples + firstLen, (len - firstLen) * sizeof(int16_t));
+
+    atomic_store_explicit(&ring->writeIdx, writeIdx + len, memory_order_release);
+}
+
+// seqlock style: copies first, then checks whether the producer has reached
+// from + RING_BUF_SIZE, which would have overwritten the oldest copied sample
+static bool ringCopy(const struct SampleRing *ring, size_t from, int16_t *out, size_t len) {
+    size_t start = from & (RING_BUF_SIZE - 1);
+    size_t firstLen = RING_BUF_SIZE - start < len ? RING_BUF_SIZE - start : len;
+    memcpy(out, ring->buf + start, firstLen * sizeof(int16_t));
+    memcpy(out + firstLen, ring->buf, (len - firstLen) * sizeof(int16_t));
+
+    atomic_thread_fence(memory_order_acquire);
+    size_t writeEnd = atomic_load_explicit(&ring->writeEnd, memory_order_relaxed);
+    return writeEnd - from <= RING_BUF_SIZE;
+}
+
+size_t ringReadLatest(struct SampleRing *ring, int16_t *out, size_t len) {
+    size_t writeIdx = atomic_load_explicit(&ring->writeIdx, memory_order_acquire);
+
+    if (len > RING_READABLE) len = RING_READABLE;
+    if (len > writeIdx) len = writeIdx;
+
+    if (!ringCopy(ring, writeIdx - len, out, len)) return 0;
+    return len;
+}
+
+size_t ringWriteCount(struct SampleRing *ring) {
+    return atomic_load_explicit(&ring->writeIdx, memory_order_acquire);
+}
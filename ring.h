@@ -0,0 +1,28 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_BUF_SIZE 16384
+
+// single-producer sample tap: the audio thread writes blocks without ever
+// waiting, readers on other threads copy out whatever is recent enough and
+// throw the copy away when the producer overwrote it meanwhile
+struct SampleRing {
+    int16_t buf[RING_BUF_SIZE];
+    // samples published so far
+    atomic_size_t writeIdx;
+    // where the block being written ends, ahead of writeIdx during a write
+    atomic_size_t writeEnd;
+};
+
+void ringInit(struct SampleRing *ring);
+void ringWrite(struct SampleRing *ring, const int16_t *samples, size_t len);
+// copies the newest len samples, returns fewer when there aren't that many
+// yet and 0 when the producer lapped the copy
+size_t ringReadLatest(struct SampleRing *ring, int16_t *out, size_t len);
+size_t ringWriteCount(struct SampleRing *ring);
+
+#endif //RING_H
@@ -0,0 +1,207 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "rtcheck.h"
+
+#ifdef SYNTH_RTCHECK
+
+#include <execinfo.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RT_MAX_SITES 64
+#define RT_MAX_FRAMES 24
+// rtRecord and the wrapper it was called from
+#define RT_SKIP_FRAMES 2
+
+// one place the audio path made a call it shouldn't. a slot is claimed by
+// swapping its key in, the recording thread fills the rest and publishes it
+// with isReady
+struct RtSite {
+    atomic_uintptr_t key;
+    atomic_bool isReady;
+    atomic_size_t count;
+    const char *call;
+    void *frames[RT_MAX_FRAMES];
+    int framesLen;
+};
+
+static struct RtSite sites[RT_MAX_SITES];
+// calls that found the table full
+static atomic_size_t dropped;
+static _Thread_local unsigned depth;
+
+// backtrace loads the unwinder on its first call, that has to happen before
+// any thread is realtime
+__attribute__((constructor)) static void rtStart(void) {
+    void *frames[1];
+    backtrace(frames, 1);
+    atexit(rtReport);
+}
+
+void rtEnter(void) {
+    depth++;
+}
+
+void rtLeave(void) {
+    depth--;
+}
+
+static uintptr_t siteKey(const char *call, void **frames, int framesLen) {
+    uintptr_t key = (uintptr_t) call;
+    for (int i = 0; i < framesLen; i++) key = (key ^ (uintptr_t) frames[i]) * 0x100000001b3u;
+    return key != 0 ? key : 1;
+}
+
+// called from every wrapper, so it can't use anything that is wrapped itself
+static void rtRecord(const char *call) {
+    if (depth == 0) return;
+
+    void *frames[RT_MAX_FRAMES + RT_SKIP_FRAMES];
+    int framesLen = backtrace(frames, RT_MAX_FRAMES + RT_SKIP_FRAMES) - RT_SKIP_FRAMES;
+    if (framesLen < 0) framesLen = 0;
+    uintptr_t key = siteKey(call, frames + RT_SKIP_FRAMES, framesLen);
+
+    for (size_t probe = 0; probe < RT_MAX_SITES; probe++) {
+        struct RtSite *site = &sites[(key + probe) % RT_MAX_SITES];
+        uintptr_t seen = atomic_load_explicit(&site->key, memory_order_relaxed);
+        if (seen == 0 && atomic_compare_exchange_strong_explicit(&site->key, &seen, key, memory_order_relaxed, memory_order_relaxed)) {
+            site->call = call;
+            for (int i = 0; i < framesLen; i++) site->frames[i] = frames[RT_SKIP_FRAMES + i];
+            site->framesLen = framesLen;
+            atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed);
+            atomic_store_explicit(&site->isReady, true, memory_order_release);
+            return;
+        }
+        if (seen == key) {
+            atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+}
+
+size_t rtViolations(void) {
+    size_t found = 0;
+    for (size_t i = 0; i < RT_MAX_SITES; i++) {
+        if (atomic_load_explicit(&sites[i].isReady, memory_order_acquire)) found++;
+    }
+    return found;
+}
+
+void rtReport(void) {
+    // exit may run this on a realtime thread, the report itself is fine
+    depth = 0;
+
+    size_t found = rtViolations();
+    if (found == 0) return;
+    fprintf(stderr, "rtcheck: %zu call site%s blocked a realtime thread\n", found, found > 1 ? "s" : "");
+    fprintf(stderr, "static functions show as offsets, addr2line -f -e <binary> <offset> names them\n");
+    for (size_t i = 0; i < RT_MAX_SITES; i++) {
+        struct RtSite *site = &sites[i];
+        if (!atomic_load_explicit(&site->isReady, memory_order_acquire)) continue;
+        fprintf(stderr, "\n%s, %zu time%s\n", site->call, atomic_load(&site->count), atomic_load(&site->count) > 1 ? "s" : "");
+        backtrace_symbols_fd(site->frames, site->framesLen, STDERR_FILENO);
+    }
+    size_t lost = atomic_load(&dropped);
+    if (lost > 0) fprintf(stderr, "\nrtcheck: %zu more calls from sites past the first %d\n", lost, RT_MAX_SITES);
+}
+
+// the rtcheck build links with -Wl,--wrap=name for every one of these, so
+// calls from our own objects land here first. calls libc or libsoundio make
+// internally aren't seen
+#define RT_WRAP(ret, name, params, args) \
+    ret __real_##name params; \
+    ret __wrap_##name params { \
+        rtRecord(#name); \
+        return __real_##name args; \
+    }
+
+RT_WRAP(void *, malloc, (size_t size), (size))
+RT_WRAP(void *, calloc, (size_t count, size_t size), (count, size))
+RT_WRAP(void *, realloc, (void *ptr, size_t size), (ptr, size))
+RT_WRAP(void *, aligned_alloc, (size_t align, size_t size), (align, size))
+RT_WRAP(int, posix_memalign, (void **ptr, size_t align, size_t size), (ptr, align, size))
+
+void __real_free(void *ptr);
+void __wrap_free(void *ptr) {
+    rtRecord("free");
+    __real_free(ptr);
+}
+
+int __real_vfprintf(FILE *stream, const char *fmt, va_list args);
+int __wrap_vfprintf(FILE *stream, const char *fmt, va_list args) {
+    rtRecord("vfprintf");
+    return __real_vfprintf(stream, fmt, args);
+}
+
+int __wrap_vprintf(const char *fmt, va_list args) {
+    rtRecord("vprintf");
+    return __real_vfprintf(stdout, fmt, args);
+}
+
+int __wrap_fprintf(FILE *stream, const char *fmt, ...) {
+    rtRecord("fprintf");
+    va_list args;
+    va_start(args, fmt);
+    int written = __real_vfprintf(stream, fmt, args);
+    va_end(args);
+    return written;
+}
+
+int __wrap_printf(const char *fmt, ...) {
+    rtRecord("printf");
+    va_list args;
+    va_start(args, fmt);
+    int written = __real_vfprintf(stdout, fmt, args);
+    va_end(args);
+    return written;
+}
+
+// gcc turns constant printfs into these
+RT_WRAP(int, puts, (const char *str), (str))
+RT_WRAP(int, putchar, (int c), (c))
+RT_WRAP(int, fputs, (const char *str, FILE *stream), (str, stream))
+RT_WRAP(int, fputc, (int c, FILE *stream), (c, stream))
+RT_WRAP(size_t, fwrite, (const void *ptr, size_t size, size_t count, FILE *stream), (ptr, size, count, stream))
+RT_WRAP(int, fflush, (FILE *stream), (stream))
+RT_WRAP(FILE *, fopen, (const char *path, const char *mode), (path, mode))
+RT_WRAP(int, fclose, (FILE *stream), (stream))
+
+RT_WRAP(int, pthread_mutex_lock, (pthread_mutex_t *mutex), (mutex))
+RT_WRAP(int, pthread_cond_wait, (pthread_cond_t *cond, pthread_mutex_t *mutex), (cond, mutex))
+RT_WRAP(int, pthread_cond_timedwait, (pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime),
+        (cond, mutex, abstime))
+RT_WRAP(int, pthread_join, (pthread_t thread, void **result), (thread, result))
+RT_WRAP(int, sem_wait, (sem_t *sem), (sem))
+RT_WRAP(int, sem_timedwait, (sem_t *sem, const struct timespec *abstime), (sem, abstime))
+
+RT_WRAP(int, nanosleep, (const struct timespec *req, struct timespec *rem), (req, rem))
+RT_WRAP(unsigned, sleep, (unsigned secs), (secs))
+RT_WRAP(ssize_t, read, (int fd, void *buf, size_t len), (fd, buf, len))
+RT_WRAP(ssize_t, write, (int fd, const void *buf, size_t len), (fd, buf, len))
+RT_WRAP(int, poll, (struct pollfd *fds, nfds_t fdsLen, int timeout), (fds, fdsLen, timeout))
+RT_WRAP(void *, mmap, (void *addr, size_t len, int prot, int flags, int fd, off_t offset), (addr, len, prot, flags, fd, offset))
+RT_WRAP(int, munmap, (void *addr, size_t len), (addr, len))
+
+_Noreturn void __real_exit(int status);
+_Noreturn void __wrap_exit(int status) {
+    rtRecord("exit");
+    __real_exit(status);
+}
+
+#else
+
+// iso c wants something in every translation unit
+typedef int rtcheckDisabled;
+
+#endif
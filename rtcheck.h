@@ -0,0 +1,32 @@
+#ifndef RTCHECK_H
+#define RTCHECK_H
+
+#include <stddef.h>
+
+// catches the audio path doing things that can block: allocating, stdio,
+// taking locks, sleeping or making blocking syscalls. threads mark the
+// stretches that must keep up with the device, and in a make rtcheck build
+// the interposed calls record where they were made from while a thread is
+// marked. every distinct call site is printed with a backtrace at exit.
+// in a normal build the marks compile away
+
+#ifdef SYNTH_RTCHECK
+
+// marks may nest, the thread stays realtime until the outermost rtLeave
+void rtEnter(void);
+void rtLeave(void);
+// distinct call sites recorded so far
+size_t rtViolations(void);
+// prints every violation to stderr, also registered to run at exit
+void rtReport(void);
+
+#else
+
+#define rtEnter() ((void) 0)
+#define rtLeave() ((void) 0)
+#define rtViolations() ((size_t) 0)
+#define rtReport() ((void) 0)
+
+#endif
+
+#endif //RTCHECK_H
@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "rtsched.h"
+
+// pages are at least this big, touching every one of them is enough
+#define RTSCHED_PAGE 4096
+
+static void rtschedAppend(struct RtSched *rt, const char *fmt, va_list args) {
+    size_t room = RTSCHED_LOG_LEN - rt->_priv.logLen;
+    int len = vsnprintf(rt->_priv.log + rt->_priv.logLen, room, fmt, args);
+    if (len < 0) return;
+    rt->_priv.logLen += (size_t) len < room ? (size_t) len : room - 1;
+}
+
+static void rtschedLog(struct RtSched *rt, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    rtschedAppend(rt, fmt, args);
+    va_end(args);
+}
+
+void rtschedFallback(struct RtSched *rt, const char *fmt, ...) {
+    rt->_priv.isDegraded = true;
+    va_list args;
+    va_start(args, fmt);
+    rtschedAppend(rt, fmt, args);
+    va_end(args);
+}
+
+int rtschedParsePriority(struct RtSched *rt, const char *arg) {
+    char *end;
+    long priority = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO)) {
+        fprintf(stderr, "bad priority %s, SCHED_FIFO takes %d to %d\n", arg,
+                sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        return -1;
+    }
+    rt->priority = (int) priority;
+    return 0;
+}
+
+int rtschedParseCpus(struct RtSched *rt, const char *list) {
+    const char *at = list;
+    rt->cpusLen = 0;
+    for (;;) {
+        char *end;
+        long first = strtol(at, &end, 10);
+        long last = first;
+        if (end == at) break;
+        if (*end == '-') {
+            at = end + 1;
+            last = strtol(at, &end, 10);
+            if (end == at) break;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE || (size_t) (last - first) >= RTSCHED_MAX_CPUS - rt->cpusLen) break;
+
+        for (long cpu = first; cpu <= last; cpu++) rt->cpus[rt->cpusLen++] = (int) cpu;
+        if (*end == '\0') return 0;
+        if (*end != ',') break;
+        at = end + 1;
+    }
+    fprintf(stderr, "bad cpu list %s\n", list);
+    return -1;
+}
+
+void rtschedLockMemory(struct RtSched *rt) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+        rtschedLog(rt, "  memory: locked, later allocations are faulted in as they're made\n");
+        return;
+    }
+    int err = errno;
+
+    char limitText[32] = "unknown";
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0) {
+        if (limit.rlim_cur == RLIM_INFINITY) snprintf(limitText, sizeof(limitText), "unlimited");
+        else snprintf(limitText, sizeof(limitText), "%llu kB", (unsigned long long) limit.rlim_cur / 1024);
+    }
+    rtschedFallback(rt, "  memory: mlockall failed, %s (memlock limit %s). raise it with ulimit -l or run with CAP_IPC_LOCK.\n"
+               "          arenas are still zero filled when allocated and the realtime stacks touched, but can be paged out\n",
+               strerror(err), limitText);
+}
+
+static void rtschedApplyPriority(struct RtSched *rt, pthread_t thread, const char *name) {
+    int priority = rt->priority;
+    struct sched_param param = { .sched_priority = priority };
+    int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+
+    // an rtprio limit below the request still allows realtime, just lower
+    struct rlimit limit;
+    if (err == EPERM && getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur > 0 && limit.rlim_cur < (rlim_t) priority) {
+        priority = (int) limit.rlim_cur;
+        param.sched_priority = priority;
+        err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    }
+
+    if (err == 0 && priority == rt->priority) {
+        rtschedLog(rt, "  %s: SCHED_FIFO priority %d\n", name, priority);
+    } else if (err == 0) {
+        rtschedFallback(rt, "  %s: SCHED_FIFO priority %d, the rtprio limit is below %d\n", name, priority, rt->priority);
+    } else if (err == EPERM) {
+        rtschedFallback(rt, "  %s: SCHED_FIFO not permitted, left at normal priority. allow it with CAP_SYS_NICE or an rtprio limit (ulimit -r)\n", name);
+    } else {
+        rtschedFallback(rt, "  %s: SCHED_FIFO priority %d failed, %s\n", name, priority, strerror(err));
+    }
+}
+
+void rtschedApply(struct RtSched *rt, pthread_t thread, const char *name, size_t index) {
+    if (rt->priority > 0) rtschedApplyPriority(rt, thread, name);
+    if (rt->cpusLen == 0) return;
+
+    int cpu = rt->cpus[index % rt->cpusLen];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err == 0) {
+        rtschedLog(rt, "  %s: pinned to cpu %d\n", name, cpu);
+    } else {
+        rtschedFallback(rt, "  %s: can't pin to cpu %d, %s, left unpinned\n", name, cpu, strerror(err));
+    }
+}
+
+// kept out of line so the touched frame sits below the caller's, where the
+// calls it makes next will put theirs
+__attribute__((noinline)) void rtschedPrefaultStack(void) {
+    volatile char stack[RTSCHED_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += RTSCHED_PAGE) stack[i] = 0;
+}
+
+void rtschedReport(const struct RtSched *rt, FILE *out) {
+    if (rt->_priv.logLen == 0) return;
+    fprintf(out, "realtime setup%s:\n%s", rt->_priv.isDegraded ? ", partly fell back" : "", rt->_priv.log);
+}
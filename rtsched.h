@@ -0,0 +1,53 @@
+#ifndef RTSCHED_H
+#define RTSCHED_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define RTSCHED_MAX_CPUS 64
+// stack a realtime thread touches before its first block, well past what the
+// callback and a render task use
+#define RTSCHED_STACK_PREFAULT (64 * 1024)
+#define RTSCHED_LOG_LEN 2048
+
+// realtime setup for the audio callback and the render workers. everything
+// here is best effort: what the host doesn't permit is logged with how to
+// allow it, and the synth keeps running the way it would have without it
+struct RtSched {
+    // SCHED_FIFO priority, 0 leaves scheduling alone
+    int priority;
+    // the n-th realtime thread is pinned to cpus[n % cpusLen], none when empty
+    int cpus[RTSCHED_MAX_CPUS];
+    size_t cpusLen;
+    struct {
+        char log[RTSCHED_LOG_LEN];
+        size_t logLen;
+        bool isDegraded;
+    } _priv;
+};
+
+// the command line forms, both print what's wrong and return -1 when the
+// argument doesn't parse. priorities are SCHED_FIFO's 1 to 99, cpu lists look
+// like 2,3 or 2-5,7
+int rtschedParsePriority(struct RtSched *rt, const char *arg);
+int rtschedParseCpus(struct RtSched *rt, const char *list);
+// mlockall, so every arena, table, mapped sample and thread stack stays
+// resident and anything allocated later is faulted in as it's allocated
+void rtschedLockMemory(struct RtSched *rt);
+// raises thread to the configured priority and pins it, from any thread.
+// index picks the cpu, name labels it in the log
+void rtschedApply(struct RtSched *rt, pthread_t thread, const char *name, size_t index);
+// faults in RTSCHED_STACK_PREFAULT bytes of the calling thread's stack, so
+// the first block doesn't take its page faults. the faults themselves take
+// time, so call it where a late block doesn't matter, like a first audio
+// callback that only plays silence
+void rtschedPrefaultStack(void);
+// logs something the host didn't allow, for setup the caller does itself
+void rtschedFallback(struct RtSched *rt, const char *fmt, ...);
+// what was applied and what fell back. the tui owns the screen while the
+// synth runs, so this is for after the terminal is restored
+void rtschedReport(const struct RtSched *rt, FILE *out);
+
+#endif //RTSCHED_H
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sampler.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_EXTENSIBLE 0xfffe
+
+static uint32_t readLe32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t readLe16(const unsigned char *p) {
+    return p[0] | p[1] << 8;
+}
+
+static int wavError(const char *path, const char *msg) {
+    fprintf(stderr, "%s: %s\n", path, msg);
+    return -1;
+}
+
+// walks the RIFF chunks for fmt and data, the samples stay in the mapping
+static int parseWav(struct SampleData *sample, const char *path) {
+    const unsigned char *data = sample->_priv.map;
+    size_t len = sample->_priv.mapLen;
+
+    if (len < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+        return wavError(path, "not a WAV file");
+
+    bool hasFmt = false;
+    size_t pos = 12;
+    while (len - pos >= 8) {
+        const unsigned char *chunk = data + pos;
+        size_t chunkLen = readLe32(chunk + 4);
+        pos += 8;
+        if (chunkLen > len - pos) chunkLen = len - pos;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkLen < 16) return wavError(path, "short fmt chunk");
+            uint16_t format = readLe16(chunk + 8);
+            sample->channels = readLe16(chunk + 10);
+            sample->sampleRate = readLe32(chunk + 12);
+            uint16_t bits = readLe16(chunk + 22);
+
+            if (format != WAV_FORMAT_PCM && format != WAV_FORMAT_EXTENSIBLE) return wavError(path, "not PCM");
+            if (bits != 16) return wavError(path, "only 16 bit samples are supported");
+            if (sample->channels < 1 || sample->channels > 2) return wavError(path, "only mono and stereo are supported");
+            if (sample->sampleRate <= 0) return wavError(path, "bad sample rate");
+            hasFmt = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!hasFmt) return wavError(path, "data before fmt");
+            // chunks start on even offsets, so the samples are aligned for int16_t
+            sample->frames = (const int16_t*) (data + pos);
+            sample->framesLen = chunkLen / (2 * sample->channels);
+            return sample->framesLen > 0 ? 0 : wavError(path, "no samples");
+        }
+
+        pos += chunkLen + (chunkLen & 1);
+    }
+
+    return wavError(path, "no data chunk");
+}
+
+static volatile unsigned char touchSink;
+
+// reads one byte per page so the range is resident before the audio thread gets there
+static void touchPages(const struct SampleData *sample, size_t fromFrame, size_t toFrame) {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    const unsigned char *base = sample->_priv.map;
+
+    if (toFrame > sample->framesLen) toFrame = sample->framesLen;
+    if (fromFrame >= toFrame) return;
+
+    size_t frameBytes = 2 * sample->channels;
+    size_t from = (const unsigned char*) sample->frames - base + fromFrame * frameBytes;
+    size_t to = (const unsigned char*) sample->frames - base + toFrame * frameBytes;
+    from -= from % pageSize;
+
+    posix_madvise((void*) (base + from), to - from, POSIX_MADV_WILLNEED);
+    for (size_t off = from; off < to; off += pageSize) {
+        touchSink += base[off];
+    }
+}
+
+int sampleOpen(struct SampleData *sample, const char *path) {
+    memset(sample, 0, sizeof(*sample));
+    for (size_t i = 0; i < SAMPLER_MAX_PLAYERS; i++) atomic_init(&sample->players[i], SAMPLER_PLAYER_FREE);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return wavError(path, "empty or unreadable");
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    sample->_priv.map = map;
+    sample->_priv.mapLen = st.st_size;
+
+    if (parseWav(sample, path) != 0) {
+        sampleClose(sample);
+        return -1;
+    }
+
+    // short hits are pulled in whole, long files are read ahead as they play
+    sample->isStreamed = sample->_priv.mapLen > SAMPLER_RESIDENT_BYTES;
+    if (sample->isStreamed) {
+        posix_madvise(map, sample->_priv.mapLen, POSIX_MADV_SEQUENTIAL);
+        touchPages(sample, 0, SAMPLER_PREFETCH_FRAMES);
+    } else {
+        touchPages(sample, 0, sample->framesLen);
+    }
+    return 0;
+}
+
+void sampleClose(struct SampleData *sample) {
+    if (sample->_priv.map != NULL) munmap(sample->_priv.map, sample->_priv.mapLen);
+    sample->_priv.map = NULL;
+    sample->frames = NULL;
+    sample->framesLen = 0;
+}
+
+int16_t sampleFrame(const struct SampleData *sample, size_t frame) {
+    if (sample->channels == 1) return sample->frames[frame];
+    return (sample->frames[2 * frame] + sample->frames[2 * frame + 1]) / 2;
+}
+
+int samplePlayerClaim(struct SampleData *sample) {
+    for (int i = 0; i < SAMPLER_MAX_PLAYERS; i++) {
+        size_t free = SAMPLER_PLAYER_FREE;
+        if (atomic_compare_exchange_strong(&sample->players[i], &free, SAMPLER_PLAYER_IDLE)) return i;
+    }
+    return -1;
+}
+
+void samplePlayerRelease(struct SampleData *sample, int player) {
+    if (player >= 0) atomic_store(&sample->players[player], SAMPLER_PLAYER_FREE);
+}
+
+void samplePlayerPublish(struct SampleData *sample, int player, size_t frame) {
+    if (player >= 0) atomic_store_explicit(&sample->players[player], frame, memory_order_relaxed);
+}
+
+static void *prefetcherLoop(void *arg) {
+    struct SamplePrefetcher *prefetcher = arg;
+    struct timespec interval = { 0, SAMPLER_PREFETCH_MS * 1000000L };
+
+    while (atomic_load_explicit(&prefetcher->isRunning, memory_order_relaxed)) {
+        for (size_t i = 0; i < prefetcher->samplesLen; i++) {
+            struct SampleData *sample = prefetcher->samples[i];
+            // the head stays warm too, every retrigger starts there
+            touchPages(sample, 0, SAMPLER_PREFETCH_FRAMES);
+            for (size_t player = 0; player < SAMPLER_MAX_PLAYERS; player++) {
+                size_t pos = atomic_load_explicit(&sample->players[player], memory_order_relaxed);
+                if (pos < SAMPLER_PLAYER_IDLE) touchPages(sample, pos, pos + SAMPLER_PREFETCH_FRAMES);
+            }
+        }
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+int prefetcherStart(struct SamplePrefetcher *prefetcher, struct SampleData *samples, size_t samplesLen) {
+    prefetcher->samplesLen = 0;
+    for (size_t i = 0; i < samplesLen && prefetcher->samplesLen < SAMPLER_MAX_FILES; i++) {
+        if (samples[i].isStreamed) prefetcher->samples[prefetcher->samplesLen++] = &samples[i];
+    }
+    atomic_init(&prefetcher->isRunning, prefetcher->samplesLen > 0);
+    if (prefetcher->samplesLen == 0) return 0;
+
+    if (pthread_create(&prefetcher->thread, NULL, prefetcherLoop, prefetcher) != 0) {
+        atomic_store(&prefetcher->isRunning, false);
+        return -1;
+    }
+    return 0;
+}
+
+void prefetcherStop(struct SamplePrefetcher *prefetcher) {
+    if (!atomic_exchange(&prefetcher->isRunning, false)) return;
+    pthread_join(prefetcher->thread, NULL);
+}
@@ -0,0 +1,60 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLER_MAX_FILES 32
+#define SAMPLER_PREFETCH_MS 5
+// how far ahead of the play position pages are kept resident
+#define SAMPLER_PREFETCH_FRAMES 65536
+// files up to this size are faulted in whole when opened, larger ones stream
+#define SAMPLER_RESIDENT_BYTES (8 << 20)
+// Samplers per file whose play position the prefetcher follows
+#define SAMPLER_MAX_PLAYERS 16
+// a player slot nobody holds, and one held by a Sampler that's silent
+#define SAMPLER_PLAYER_FREE SIZE_MAX
+#define SAMPLER_PLAYER_IDLE (SIZE_MAX - 1)
+
+// 16 bit PCM from a memory-mapped WAV file, shared by every Sampler playing it
+struct SampleData {
+    const int16_t *frames;
+    size_t framesLen;
+    unsigned channels;
+    float sampleRate;
+    bool isStreamed;
+    // the frame each player has reached, published once per block. the
+    // prefetcher keeps the pages after every one of them warm
+    atomic_size_t players[SAMPLER_MAX_PLAYERS];
+
+    struct {
+        void *map;
+        size_t mapLen;
+    } _priv;
+};
+
+// touches upcoming pages of streamed files so the audio thread never faults
+struct SamplePrefetcher {
+    struct SampleData *samples[SAMPLER_MAX_FILES];
+    size_t samplesLen;
+    atomic_bool isRunning;
+    pthread_t thread;
+};
+
+int sampleOpen(struct SampleData *sample, const char *path);
+void sampleClose(struct SampleData *sample);
+int16_t sampleFrame(const struct SampleData *sample, size_t frame);
+// a slot for one player's position, -1 when all SAMPLER_MAX_PLAYERS are taken
+// and the prefetcher can only keep the head of the file warm for it
+int samplePlayerClaim(struct SampleData *sample);
+void samplePlayerRelease(struct SampleData *sample, int player);
+// frame is SAMPLER_PLAYER_IDLE while the player is silent
+void samplePlayerPublish(struct SampleData *sample, int player, size_t frame);
+
+int prefetcherStart(struct SamplePrefetcher *prefetcher, struct SampleData *samples, size_t samplesLen);
+void prefetcherStop(struct SamplePrefetcher *prefetcher);
+
+#endif //SAMPLER_H
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tui.h"
+#include "screen.h"
+
+// worst case per cell: cursor move, reset, bold, fg, bold again, bg and a 4 byte glyph
+#define CELL_OUT_MAX 48
+
+static struct Cell frontBuf[SCREEN_MAX_HEIGHT][SCREEN_MAX_WIDTH];
+static struct Cell backBuf[SCREEN_MAX_HEIGHT][SCREEN_MAX_WIDTH];
+static char outBuf[SCREEN_MAX_HEIGHT * SCREEN_MAX_WIDTH * CELL_OUT_MAX];
+static int screenWidth;
+static int screenHeight;
+
+static const struct Cell blankCell = {
+    .glyph = " ",
+    .fg = CLR_DEFAULT,
+    .bg = CLR_DEFAULT,
+    .attrs = 0
+};
+
+void screenInit(int width, int height) {
+    screenWidth = width > SCREEN_MAX_WIDTH ? SCREEN_MAX_WIDTH : width;
+    screenHeight = height > SCREEN_MAX_HEIGHT ? SCREEN_MAX_HEIGHT : height;
+
+    // both buffers start out matching a freshly cleared terminal
+    for (int y = 0; y < SCREEN_MAX_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_MAX_WIDTH; x++) {
+            frontBuf[y][x] = blankCell;
+            backBuf[y][x] = blankCell;
+        }
+    }
+}
+
+void screenPut(int x, int y, const char *glyph, int fg, int bg, uint8_t attrs) {
+    if (x < 1 || y < 1 || x > screenWidth || y > screenHeight) return;
+
+    struct Cell *cell = &backBuf[y - 1][x - 1];
+    size_t len = strlen(glyph);
+    if (len > CELL_GLYPH_SIZE - 1) len = CELL_GLYPH_SIZE - 1;
+
+    memcpy(cell->glyph, glyph, len);
+    cell->glyph[len] = '\0';
+    cell->fg = fg;
+    cell->bg = bg;
+    cell->attrs = attrs;
+}
+
+static int utf8Len(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if ((lead & 0xe0) == 0xc0) return 2;
+    if ((lead & 0xf0) == 0xe0) return 3;
+    if ((lead & 0xf8) == 0xf0) return 4;
+    return 1;
+}
+
+int screenPutStr(int x, int y, const char *str, int maxCells, int fg, int bg, uint8_t attrs) {
+    int cells = 0;
+    char glyph[CELL_GLYPH_SIZE];
+
+    while (*str != '\0' && (maxCells < 0 || cells < maxCells)) {
+        int len = utf8Len(*str);
+        int i;
+        for (i = 0; i < len && str[i] != '\0'; i++) {
+            glyph[i] = str[i];
+        }
+        glyph[i] = '\0';
+
+        screenPut(x + cells, y, glyph, fg, bg, attrs);
+        str += i;
+        ++cells;
+    }
+
+    return cells;
+}
+
+void screenInvalidate(void) {
+    // an empty glyph never matches a drawn cell, so everything is resent
+    for (int y = 0; y < SCREEN_MAX_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_MAX_WIDTH; x++) {
+            frontBuf[y][x].glyph[0] = '\0';
+        }
+    }
+}
+
+static bool cellEqual(const struct Cell *a, const struct Cell *b) {
+    return a->fg == b->fg
+        && a->bg == b->bg
+        && a->attrs == b->attrs
+        && strcmp(a->glyph, b->glyph) == 0;
+}
+
+static size_t appendStr(size_t len, const char *str) {
+    size_t strLen = strlen(str);
+    memcpy(outBuf + len, str, strLen);
+    return len + strLen;
+}
+
+void screenPresent(void) {
+    size_t len = 0;
+    int cursorX = -1;
+    int cursorY = -1;
+    bool penKnown = false;
+    struct Cell pen = blankCell;
+
+    for (int y = 0; y < screenHeight; y++) {
+        for (int x = 0; x < screenWidth; x++) {
+            struct Cell *back = &backBuf[y][x];
+            struct Cell *front = &frontBuf[y][x];
+            if (cellEqual(back, front)) continue;
+
+            if (cursorX != x || cursorY != y) {
+                len += sprintf(outBuf + len, "\033[%d;%dH", y + 1, x + 1);
+            }
+
+            if (!penKnown || back->attrs != pen.attrs) {
+                len = appendStr(len, TEXT_RESET);
+                if (back->attrs & CELL_BOLD) len = appendStr(len, TEXT_BOLD);
+                pen.fg = CLR_DEFAULT;
+                pen.bg = CLR_DEFAULT;
+                pen.attrs = back->attrs;
+                penKnown = true;
+            }
+            if (back->fg != pen.fg) {
+                // every foreground code also clears bold, so restore it
+                len = appendStr(len, back->fg == CLR_DEFAULT ? "\033[22;39m" : clrsFG[back->fg]);
+                if (pen.attrs & CELL_BOLD) len = appendStr(len, TEXT_BOLD);
+                pen.fg = back->fg;
+            }
+            if (back->bg != pen.bg) {
+                len = appendStr(len, back->bg == CLR_DEFAULT ? "\033[49m" : clrsBG[back->bg]);
+                pen.bg = back->bg;
+            }
+
+            len = appendStr(len, back->glyph);
+            *front = *back;
+            cursorX = x + 1;
+            cursorY = y;
+        }
+    }
+
+    if (len == 0) return;
+
+    // anything still sitting in stdio has to reach the terminal first
+    fflush(stdout);
+    size_t written = 0;
+    while (written < len) {
+        ssize_t ret = write(STDOUT_FILENO, outBuf + written, len - written);
+        if (ret <= 0) break;
+        written += ret;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdint.h>
+
+#define SCREEN_MAX_WIDTH 256
+#define SCREEN_MAX_HEIGHT 96
+#define CELL_GLYPH_SIZE 5
+
+// fg/bg value for the terminal's own default colour
+#define CLR_DEFAULT (-1)
+
+enum CellAttr {
+    CELL_BOLD = 1 << 0,
+};
+
+struct Cell {
+    char glyph[CELL_GLYPH_SIZE];
+    int8_t fg;
+    int8_t bg;
+    uint8_t attrs;
+};
+
+// draw calls write cells into the back buffer, screenPresent diffs it against
+// what is on the terminal and sends only the changed cells in one write().
+// coordinates are 1-based like SET_CURSOR_POS, cells off screen are dropped
+void screenInit(int width, int height);
+void screenPut(int x, int y, const char *glyph, int fg, int bg, uint8_t attrs);
+int screenPutStr(int x, int y, const char *str, int maxCells, int fg, int bg, uint8_t attrs);
+void screenInvalidate(void);
+void screenPresent(void);
+
+#endif //SCREEN_H
@@ -0,0 +1,97 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "swap.h"
+
+void swapInit(struct SynthSwap *swap, struct Synth *initial) {
+    atomic_init(&swap->pending, NULL);
+    atomic_init(&swap->retired, NULL);
+    swap->_priv.current = initial;
+    swap->_priv.fading = NULL;
+    swap->_priv.fadePos = 0;
+    swap->_priv.fadeLen = 0;
+}
+
+int swapPublish(struct SynthSwap *swap, struct Synth *next, struct Synth **superseded) {
+    *superseded = NULL;
+    // everything that allocates or builds tables happens here, not on the audio
+    // thread, which would otherwise retry a failed init on every block
+    if (!next->_priv.isInit && synthInit(next) != 0) return -1;
+    *superseded = atomic_exchange_explicit(&swap->pending, next, memory_order_acq_rel);
+    return 0;
+}
+
+struct Synth *swapReclaim(struct SynthSwap *swap) {
+    return atomic_exchange_explicit(&swap->retired, NULL, memory_order_acquire);
+}
+
+static void swapBegin(struct SynthSwap *swap) {
+    // one fade at a time, and the last outgoing graph has to be reclaimed first
+    if (swap->_priv.fading != NULL) return;
+    if (atomic_load_explicit(&swap->retired, memory_order_relaxed) != NULL) return;
+
+    struct Synth *next = atomic_exchange_explicit(&swap->pending, NULL, memory_order_acquire);
+    if (next == NULL) return;
+
+    swap->_priv.fading = swap->_priv.current;
+    swap->_priv.current = next;
+    swap->_priv.fadePos = 0;
+    swap->_priv.fadeLen = next->sampleRate * SWAP_FADE_MS / 1000;
+    if (swap->_priv.fadeLen == 0) swap->_priv.fadeLen = 1;
+}
+
+static void swapFadeBlock(struct SynthSwap *swap, int16_t *outBuf, size_t frames) {
+    size_t fadeLeft = swap->_priv.fadeLen - swap->_priv.fadePos;
+    size_t fadeFrames = frames < fadeLeft ? frames : fadeLeft;
+    int16_t *oldBuf = swap->_priv.fadeBuf;
+
+    synthRunBlockStereo(swap->_priv.fading, oldBuf, fadeFrames);
+
+    int32_t len = swap->_priv.fadeLen;
+    for (size_t frame = 0; frame < fadeFrames; frame++) {
+        int32_t pos = swap->_priv.fadePos + frame;
+        for (size_t i = 2 * frame; i < 2 * frame + 2; i++) {
+            outBuf[i] = (oldBuf[i] * (len - pos) + outBuf[i] * pos) / len;
+        }
+    }
+
+    swap->_priv.fadePos += fadeFrames;
+    if (swap->_priv.fadePos == swap->_priv.fadeLen) {
+        atomic_store_explicit(&swap->retired, swap->_priv.fading, memory_order_release);
+        swap->_priv.fading = NULL;
+    }
+}
+
+void swapRunBlock(struct SynthSwap *swap, int16_t *outBuf, size_t frames) {
+    swapBegin(swap);
+
+    if (swap->_priv.current == NULL) {
+        memset(outBuf, 0, 2 * frames * sizeof(int16_t));
+        return;
+    }
+
+    for (size_t frame = 0; frame < frames; frame += STREAM_BUF_SIZE) {
+        size_t blockLen = frames - frame < STREAM_BUF_SIZE ? frames - frame : STREAM_BUF_SIZE;
+        synthRunBlockStereo(swap->_priv.current, outBuf + 2 * frame, blockLen);
+        if (swap->_priv.fading != NULL) swapFadeBlock(swap, outBuf + 2 * frame, blockLen);
+    }
+}
+
+size_t swapClose(struct SynthSwap *swap, struct Synth **synths) {
+    struct Synth *held[SWAP_MAX_SYNTHS] = {
+        swap->_priv.current,
+        swap->_priv.fading,
+        atomic_exchange(&swap->pending, NULL),
+        atomic_exchange(&swap->retired, NULL),
+    };
+
+    size_t len = 0;
+    for (size_t i = 0; i < SWAP_MAX_SYNTHS; i++) {
+        if (held[i] != NULL) synths[len++] = held[i];
+    }
+    swap->_priv.current = NULL;
+    swap->_priv.fading = NULL;
+    return len;
+}
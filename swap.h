@@ -0,0 +1,43 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+#define SWAP_FADE_MS 20
+#define SWAP_MAX_SYNTHS 4
+
+// hands whole Synth graphs to the audio thread: the control thread builds and
+// inits a graph, publishes it, and the audio thread picks it up at the start
+// of a block and crossfades from the old one. graphs that finished fading out
+// come back through swapReclaim so they can be freed off the audio thread
+struct SynthSwap {
+    _Atomic(struct Synth*) pending;
+    _Atomic(struct Synth*) retired;
+
+    struct {
+        struct Synth *current;
+        struct Synth *fading;
+        size_t fadePos;
+        size_t fadeLen;
+        int16_t fadeBuf[2 * STREAM_BUF_SIZE];
+    } _priv;
+};
+
+void swapInit(struct SynthSwap *swap, struct Synth *initial);
+// control thread; inits next if it isn't yet and hands it over, setting
+// superseded to an earlier graph the audio thread never picked up. -1 when
+// next fails to init, it's left unpublished for the caller to free
+int swapPublish(struct SynthSwap *swap, struct Synth *next, struct Synth **superseded);
+// control thread; a graph the audio thread is done with, or NULL
+struct Synth *swapReclaim(struct SynthSwap *swap);
+// audio thread, renders frames of interleaved stereo
+void swapRunBlock(struct SynthSwap *swap, int16_t *outBuf, size_t frames);
+// once audio has stopped, hands back every graph still held
+size_t swapClose(struct SynthSwap *swap, struct Synth **synths);
+
+#endif //SWAP_H
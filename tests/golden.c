@@ -0,0 +1,735 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "dsp.h"
+#include "engine.h"
+#include "fft.h"
+#include "patch.h"
+#include "rtcheck.h"
+#include "sampler.h"
+#include "wavetable.h"
+
+// renders every reference patch headless with scripted input, compares it with
+// the stored golden PCM and checks render speed against a stored baseline.
+// the kernels this cpu picks get the full run, every other variant it can run
+// is checked for accuracy only. run from the repo root, --update rewrites
+// goldens and the baseline, and naming tests checks only those
+
+#define GOLDEN_SAMPLE_RATE 24000
+#define GOLDEN_FRAMES 18000
+#define GOLDEN_SEED 42
+#define GOLDEN_BLOCK 64
+#define GOLDEN_TIMING_RUNS 9
+#define GOLDEN_SPECTRUM_LEN 1024
+#define GOLDEN_DEFAULT_PERF_TOLERANCE 1.5
+// absolute headroom so scheduler jitter doesn't fail the cheapest patches
+#define GOLDEN_PERF_SLACK_NS 10
+
+#define DEFAULT_PATCH_PATH "patches/default.patch"
+#define PATCH_DIR "tests/patches/"
+#define GOLDEN_DIR "tests/reference/"
+#define OUT_DIR "tests/out/"
+#define BASELINE_PATH GOLDEN_DIR "perf_baseline.txt"
+
+// a parameter the host changes through synthSetParam just before the block
+// starting at frame, a multiple of GOLDEN_BLOCK
+#define PARAMS(...) (struct SynthParam[]){ __VA_ARGS__ }, \
+    sizeof((struct SynthParam[]){ __VA_ARGS__ }) / sizeof(struct SynthParam)
+#define VAL(port, value) { port, value, NULL }
+#define HOST(port, ptr) { port, 0, ptr }
+
+struct ParamChange {
+    size_t frame;
+    int module;
+    const char *port;
+    double value;
+};
+
+struct GoldenTest {
+    const char *name;
+    // max abs and RMS in sample steps, spectral as a fraction of the golden's magnitude
+    double maxAbs;
+    double rms;
+    double spectral;
+};
+
+struct GoldenResult {
+    // changes whose module wasn't Active for the block they landed in
+    int changesMissed;
+    // the output moved away from an unchanged render before the first
+    // change's block, or not within it
+    bool isChangeMistimed;
+    double maxAbs;
+    double rms;
+    double spectral;
+    double nsPerSample;
+    struct SynthFootprint footprint;
+};
+
+// float rendering can move by an LSB between compilers and SIMD paths
+#define TOL_FLOAT 4, 1, 1e-3
+// envelope timing and noise are integer driven and must match exactly
+#define TOL_EXACT 0, 0, 0
+
+static const struct GoldenTest tests[] = {
+    { "osc_sine", TOL_FLOAT },
+    { "osc_square", TOL_FLOAT },
+    { "osc_tri", TOL_FLOAT },
+    { "osc_saw", TOL_FLOAT },
+    { "osc_noise", TOL_EXACT },
+    { "env_ad", TOL_FLOAT },
+    { "env_ar", TOL_FLOAT },
+    { "env_adr", TOL_FLOAT },
+    { "env_adsr", TOL_FLOAT },
+    { "env_adbdr", TOL_FLOAT },
+    { "amp_dist", TOL_FLOAT },
+    { "attenuator_mixer", TOL_FLOAT },
+    { "filter_rectangular", TOL_FLOAT },
+    { "filter_hamming", TOL_FLOAT },
+    { "filter_hann", TOL_FLOAT },
+    { "filter_bartlett", TOL_FLOAT },
+    { "filter_blackman", TOL_FLOAT },
+    { "sampler", TOL_FLOAT },
+    { "wavetable", TOL_FLOAT },
+    { "noise_white", TOL_EXACT },
+    { "noise_pink", TOL_FLOAT },
+    { "noise_band", TOL_FLOAT },
+    { "unison", TOL_FLOAT },
+    { "unison_narrow", TOL_FLOAT },
+    { "delay", 16, 2, 2e-3 },
+    { "reverb", 16, 2, 2e-3 },
+    { "poly_idle", TOL_FLOAT },
+    { "parallel_branches", 16, 2, 2e-3 },
+    { "set_param", TOL_FLOAT },
+};
+
+#define TESTS_LEN (sizeof(tests) / sizeof(tests[0]))
+
+// set_param's first change lands mid-attack of the first note, the second
+// while the filter has settled on silence between the notes and would
+// otherwise idle. each change has to mark its module Active for the block it
+// lands in, and the output has to match an unchanged render until the first
+static const struct ParamChange setParamChanges[] = {
+    { 320, 0, "attackMs", 5 },
+    { 8448, 2, "window", WINDOW_Blackman },
+};
+
+static const struct {
+    const char *name;
+    const struct ParamChange *changes;
+    size_t changesLen;
+} changeScripts[] = {
+    { "set_param", setParamChanges, sizeof(setParamChanges) / sizeof(setParamChanges[0]) },
+};
+
+static const struct ParamChange *changesFor(const char *name, size_t *changesLen) {
+    for (size_t i = 0; i < sizeof(changeScripts) / sizeof(changeScripts[0]); i++) {
+        if (strcmp(changeScripts[i].name, name) == 0) {
+            *changesLen = changeScripts[i].changesLen;
+            return changeScripts[i].changes;
+        }
+    }
+    *changesLen = 0;
+    return NULL;
+}
+
+struct NoteEvent {
+    size_t frame;
+    float freq;
+    bool gate;
+};
+
+// two notes with a gap, so every envelope sees attack, release and a retrigger
+static const struct NoteEvent script[] = {
+    { 0, 220, true },
+    { 7200, 220, false },
+    { 9600, 330, true },
+    { 14400, 330, false },
+};
+
+#define SCRIPT_LEN (sizeof(script) / sizeof(script[0]))
+
+struct Host {
+    int16_t freq;
+    bool gate;
+    struct SampleData sample;
+    struct WavetableBank *table;
+};
+
+
+static int writeWav(const char *path, const int16_t *samples, size_t len, uint32_t sampleRate) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    uint32_t dataLen = len * sizeof(int16_t);
+    uint32_t riffLen = 36 + dataLen;
+    uint32_t fmtLen = 16;
+    uint16_t format = 1, channels = 1, blockAlign = 2, bits = 16;
+    uint32_t byteRate = sampleRate * blockAlign;
+
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riffLen, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtLen, 4, 1, file);
+    fwrite(&format, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&sampleRate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&dataLen, 4, 1, file);
+    fwrite(samples, sizeof(int16_t), len, file);
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+// the Sampler and WavetableOsc tests play files generated here, so the
+// suite carries no binary inputs besides the goldens
+static int hostInit(struct Host *host) {
+    static int16_t hit[GOLDEN_SAMPLE_RATE / 4];
+    static int16_t table[4 * WAVETABLE_FRAME_LEN];
+
+    for (size_t i = 0; i < sizeof(hit) / sizeof(hit[0]); i++) {
+        float t = (float) i / GOLDEN_SAMPLE_RATE;
+        hit[i] = 20000 * expf(-12 * t) * (sinf(M_TAU * 220 * t) + 0.3f * sinf(M_TAU * 660 * t));
+    }
+    // four frames morphing from saw to square
+    for (size_t frame = 0; frame < 4; frame++) {
+        for (size_t i = 0; i < WAVETABLE_FRAME_LEN; i++) {
+            float phase = (float) i / WAVETABLE_FRAME_LEN;
+            float saw = 2 * phase - 1;
+            float square = phase < 0.5f ? 1 : -1;
+            table[frame * WAVETABLE_FRAME_LEN + i] = 16000 * (saw + (square - saw) * frame / 3.0f);
+        }
+    }
+
+    if (mkdir(OUT_DIR, 0755) != 0 && errno != EEXIST) {
+        perror(OUT_DIR);
+        return -1;
+    }
+    if (writeWav(OUT_DIR "hit.wav", hit, sizeof(hit) / sizeof(hit[0]), GOLDEN_SAMPLE_RATE) != 0) return -1;
+    if (writeWav(OUT_DIR "table.wav", table, sizeof(table) / sizeof(table[0]), GOLDEN_SAMPLE_RATE) != 0) return -1;
+
+    if (sampleOpen(&host->sample, OUT_DIR "hit.wav") != 0) return -1;
+    host->table = wavetableAcquire(OUT_DIR "table.wav");
+    return host->table != NULL ? 0 : -1;
+}
+
+static void hostFree(struct Host *host) {
+    sampleClose(&host->sample);
+    wavetableRelease(host->table);
+}
+
+static int loadTest(struct Synth *synth, struct Host *host, const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), PATCH_DIR "%s.patch", name);
+
+    struct PatchInput inputs[] = {
+        { "freq", PORT_Sample, &host->freq },
+        { "gate", PORT_Gate, &host->gate },
+        { "sample", PORT_SampleData, &host->sample },
+        { "table", PORT_Wavetable, host->table },
+    };
+
+    memset(synth, 0, sizeof(*synth));
+    synth->sampleRate = GOLDEN_SAMPLE_RATE;
+    if (patchLoadFile(synth, path, inputs, sizeof(inputs) / sizeof(inputs[0])) != 0) return -1;
+
+    srandqd(GOLDEN_SEED);
+    if (synthInit(synth) != 0) {
+        synthDestroy(synth);
+        return -1;
+    }
+    return 0;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// renders the whole script, returns the time spent inside the synth. changes
+// are applied and counted in missed when their module doesn't run the block
+static double render(struct Synth *synth, struct Host *host, const struct ParamChange *changes, size_t changesLen,
+                     int16_t *out, int *missed) {
+    size_t event = 0;
+    size_t change = 0;
+    double elapsed = 0;
+
+    for (size_t frame = 0; frame < GOLDEN_FRAMES; frame += GOLDEN_BLOCK) {
+        while (event < SCRIPT_LEN && script[event].frame <= frame) {
+            host->freq = freqToSample(script[event].freq);
+            host->gate = script[event].gate;
+            event++;
+        }
+        size_t firstChange = change;
+        while (change < changesLen && changes[change].frame <= frame) {
+            if (synthSetParam(synth, changes[change].module, changes[change].port, changes[change].value) != 0) (*missed)++;
+            change++;
+        }
+
+        size_t len = GOLDEN_FRAMES - frame < GOLDEN_BLOCK ? GOLDEN_FRAMES - frame : GOLDEN_BLOCK;
+        rtEnter();
+        double start = nowNs();
+        synthRunBlockStereo(synth, out + 2 * frame, len);
+        elapsed += nowNs() - start;
+        rtLeave();
+
+        for (size_t i = firstChange; i < change; i++) {
+            if (!synthModuleIsActive(synth, changes[i].module)) (*missed)++;
+        }
+    }
+    return elapsed;
+}
+
+// the first change has to show up in the block it was made before, no
+// earlier and no later
+static bool changeIsOnTime(const struct ParamChange *changes, const int16_t *changed, const int16_t *plain) {
+    size_t frame = 0;
+    while (frame < GOLDEN_FRAMES && changed[2 * frame] == plain[2 * frame] && changed[2 * frame + 1] == plain[2 * frame + 1]) frame++;
+    size_t first = changes[0].frame;
+    return frame >= first && frame < first + GOLDEN_BLOCK;
+}
+
+// relative magnitude error over hann windowed frames of the left channel
+static double spectralError(const int16_t *got, const int16_t *want, size_t frames, size_t channels) {
+    static float bufGot[GOLDEN_SPECTRUM_LEN];
+    static float bufWant[GOLDEN_SPECTRUM_LEN];
+    static float window[GOLDEN_SPECTRUM_LEN];
+    struct FftPlan *plan = fftPlanCreate(GOLDEN_SPECTRUM_LEN);
+    createFirWindow(window, WINDOW_Hann, GOLDEN_SPECTRUM_LEN);
+
+    double diff = 0;
+    double total = 0;
+    for (size_t start = 0; start + GOLDEN_SPECTRUM_LEN <= frames; start += GOLDEN_SPECTRUM_LEN / 2) {
+        for (size_t i = 0; i < GOLDEN_SPECTRUM_LEN; i++) {
+            bufGot[i] = got[(start + i) * channels] * window[i];
+            bufWant[i] = want[(start + i) * channels] * window[i];
+        }
+        fftRealForward(plan, bufGot);
+        fftRealForward(plan, bufWant);
+
+        for (size_t k = 0; k < GOLDEN_SPECTRUM_LEN / 2; k++) {
+            Cplx a = fftRealBin(plan, bufGot, k);
+            Cplx b = fftRealBin(plan, bufWant, k);
+            double magA = hypot(a.real, a.imag);
+            double magB = hypot(b.real, b.imag);
+            diff += (magA - magB) * (magA - magB);
+            total += magB * magB;
+        }
+    }
+
+    fftPlanDestroy(plan);
+    return total > 0 ? sqrt(diff / total) : sqrt(diff);
+}
+
+static void compare(const int16_t *got, const int16_t *want, size_t frames, size_t channels, struct GoldenResult *result) {
+    double maxAbs = 0;
+    double sumSq = 0;
+    for (size_t i = 0; i < frames * channels; i++) {
+        double err = fabs((double) got[i] - want[i]);
+        if (err > maxAbs) maxAbs = err;
+        sumSq += err * err;
+    }
+    result->maxAbs = maxAbs;
+    result->rms = sqrt(sumSq / (frames * channels));
+    result->spectral = spectralError(got, want, frames, channels);
+}
+
+// keeps only the channels the patch actually has, mono patches store one
+static size_t packChannels(const struct Synth *synth, const int16_t *stereo, int16_t *out) {
+    size_t channels = synth->outPtrRight != NULL ? 2 : 1;
+    for (size_t frame = 0; frame < GOLDEN_FRAMES; frame++) {
+        for (size_t channel = 0; channel < channels; channel++) {
+            out[frame * channels + channel] = stereo[2 * frame + channel];
+        }
+    }
+    return channels;
+}
+
+static int readGolden(const char *name, int16_t *out, size_t len) {
+    char path[256];
+    snprintf(path, sizeof(path), GOLDEN_DIR "%s.pcm", name);
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return -1;
+    size_t read = fread(out, sizeof(int16_t), len, file);
+    bool isAtEnd = fgetc(file) == EOF;
+    fclose(file);
+    return read == len && isAtEnd ? 0 : -1;
+}
+
+static int writeGolden(const char *name, const int16_t *samples, size_t len) {
+    char path[256];
+    snprintf(path, sizeof(path), GOLDEN_DIR "%s.pcm", name);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fwrite(samples, sizeof(int16_t), len, file);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static double baselineFor(const char *name) {
+    FILE *file = fopen(BASELINE_PATH, "r");
+    if (file == NULL) return 0;
+
+    char line[128];
+    char testName[64];
+    double ns = 0;
+    double found = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %lf", testName, &ns) == 2 && strcmp(testName, name) == 0) found = ns;
+    }
+    fclose(file);
+    return found;
+}
+
+static int runTest(const struct GoldenTest *test, struct Host *host, struct GoldenResult *result,
+                   int16_t *stereo, int16_t *got, int16_t *want, size_t *channels, int runs) {
+    double best = INFINITY;
+    size_t changesLen;
+    const struct ParamChange *changes = changesFor(test->name, &changesLen);
+
+    for (int run = 0; run < runs; run++) {
+        struct Synth synth;
+        host->freq = 0;
+        host->gate = false;
+        if (loadTest(&synth, host, test->name) != 0) return -1;
+
+        double elapsed = render(&synth, host, changes, changesLen, stereo, &result->changesMissed);
+
+        if (elapsed < best) best = elapsed;
+        if (run == 0) {
+            *channels = packChannels(&synth, stereo, got);
+            result->footprint = synthFootprint(&synth);
+        }
+        synthDestroy(&synth);
+    }
+    result->nsPerSample = best / GOLDEN_FRAMES;
+
+    if (changesLen > 0) {
+        static int16_t plain[2 * GOLDEN_FRAMES];
+        struct Synth synth;
+        int missed = 0;
+        host->freq = 0;
+        host->gate = false;
+        if (loadTest(&synth, host, test->name) != 0) return -1;
+        render(&synth, host, NULL, 0, plain, &missed);
+        synthDestroy(&synth);
+        result->isChangeMistimed = !changeIsOnTime(changes, stereo, plain);
+    }
+
+    if (readGolden(test->name, want, GOLDEN_FRAMES * *channels) != 0) return 1;
+    compare(got, want, GOLDEN_FRAMES, *channels, result);
+    return 0;
+}
+
+// the graph main.c's buildDefaultPatch builds, made with the same calls
+static int buildDefault(struct Synth *synth, struct Host *host) {
+    if (synthCreate(synth, 5) != 0) return -1;
+
+    int square = synthAddModule(synth, MODULE_Oscillator, PARAMS(
+        HOST("freqSample", &host->freq),
+        VAL("waveform", WAV_Square),
+        VAL("amt", floatToAmt(0.25)),
+    ));
+    int saw = synthAddModule(synth, MODULE_Oscillator, PARAMS(
+        HOST("freqSample", &host->freq),
+        VAL("waveform", WAV_Saw),
+    ));
+    int mix = synthAddModule(synth, MODULE_Mixer, NULL, 0);
+    int lowpass = synthAddModule(synth, MODULE_Filter, PARAMS(
+        VAL("impulseLen", 128),
+        VAL("window", WINDOW_Blackman),
+    ));
+    int env = synthAddModule(synth, MODULE_EnvelopeAdsr, PARAMS(
+        HOST("gate", &host->gate),
+        VAL("attackMs", 500),
+        VAL("decayMs", 500),
+        VAL("sustain", floatToAmt(0.2)),
+        VAL("releaseMs", 2000),
+        VAL("easing", 0.8),
+    ));
+    if (square < 0 || saw < 0 || mix < 0 || lowpass < 0 || env < 0) return -1;
+
+    if (synthConnect(synth, env, saw, "amt")
+        || synthConnect(synth, square, mix, "samplesIn")
+        || synthConnect(synth, saw, mix, "samplesIn")
+        || synthConnect(synth, mix, lowpass, "sampleIn")
+        || synthConnect(synth, env, lowpass, "cutoff")) {
+        return -1;
+    }
+    return synthSetOut(synth, saw);
+}
+
+// graphs the builder has to turn down, each leaving the synth usable. returns
+// how many it accepted
+static int checkRejects(void) {
+    int accepted = 0;
+    struct Synth synth;
+    if (synthCreate(&synth, 2) != 0) return 1;
+    synth.sampleRate = GOLDEN_SAMPLE_RATE;
+
+    // a bad param after a good one rewinds both the module and the constant
+    size_t used = synth.arena.used;
+    if (synthAddModule(&synth, MODULE_Oscillator, PARAMS(VAL("amt", 0), VAL("freqSample", 1e6))) >= 0) accepted++;
+    if (synthAddModule(&synth, MODULE_Oscillator, PARAMS(VAL("pitch", 0))) >= 0) accepted++;
+    if (synthAddModule(&synth, MODULE_Filter, PARAMS(VAL("window", WINDOW_Blackman + 1))) >= 0) accepted++;
+    if (synthAddModule(&synth, MODULE_Filter, PARAMS(VAL("impulseLen", 0))) >= 0) accepted++;
+    if (synthAddModule(&synth, MODULE_TYPE_COUNT, NULL, 0) >= 0) accepted++;
+    if (synth.arena.used != used || synth.modulesLen != 0) accepted++;
+
+    int mix = synthAddModule(&synth, MODULE_Mixer, NULL, 0);
+    int lowpass = synthAddModule(&synth, MODULE_Filter, PARAMS(VAL("impulseLen", 16), VAL("window", WINDOW_Hann)));
+    if (mix != 0 || lowpass != 1) accepted++;
+    // the module table is full
+    if (synthAddModule(&synth, MODULE_Mixer, NULL, 0) >= 0) accepted++;
+
+    if (synthConnect(&synth, mix, lowpass, "impulseLen") == 0) accepted++;
+    if (synthConnect(&synth, mix, lowpass, "nothing") == 0) accepted++;
+    if (synthConnect(&synth, 2, lowpass, "sampleIn") == 0) accepted++;
+    if (synthConnect(&synth, lowpass, -1, "sampleIn") == 0) accepted++;
+    for (int i = 0; i < SYNTH_MAX_LIST_LEN; i++) {
+        if (synthConnect(&synth, lowpass, mix, "samplesIn") != 0) accepted++;
+    }
+    if (synthConnect(&synth, lowpass, mix, "samplesIn") == 0) accepted++;
+    if (synthSetOut(&synth, 2) == 0) accepted++;
+
+    // no output, then the filter's sampleIn and cutoff are unbound
+    if (synthInit(&synth) == 0) accepted++;
+    if (synthSetOut(&synth, lowpass) != 0) accepted++;
+    if (synthInit(&synth) == 0) accepted++;
+    if (synthConnect(&synth, mix, lowpass, "sampleIn") != 0 || synthConnect(&synth, mix, lowpass, "cutoff") != 0) accepted++;
+    if (synthInit(&synth) != 0) accepted++;
+
+    // nothing changes shape once built
+    if (synthAddModule(&synth, MODULE_Mixer, NULL, 0) >= 0) accepted++;
+    if (synthConnect(&synth, mix, lowpass, "sampleIn") == 0) accepted++;
+    if (synthSetOut(&synth, mix) == 0) accepted++;
+    synthDestroy(&synth);
+    return accepted;
+}
+
+// patches/default.patch has a golden of its own, and the same graph built
+// through synthCreate and friends has to render it bit for bit
+static int checkBuilder(struct Host *host, bool isUpdate, int16_t *stereo, int16_t *got, int16_t *want) {
+    static int16_t built[2 * GOLDEN_FRAMES];
+    struct PatchInput inputs[] = {
+        { "freq", PORT_Sample, &host->freq },
+        { "gate", PORT_Gate, &host->gate },
+    };
+    struct Synth synth = { .sampleRate = GOLDEN_SAMPLE_RATE };
+    int missed = 0;
+
+    host->freq = 0;
+    host->gate = false;
+    if (patchLoadFile(&synth, DEFAULT_PATCH_PATH, inputs, sizeof(inputs) / sizeof(inputs[0])) != 0 || synthInit(&synth) != 0) {
+        printf("%-20s FAIL: %s didn't load\n", "builder", DEFAULT_PATCH_PATH);
+        synthDestroy(&synth);
+        return 1;
+    }
+    render(&synth, host, NULL, 0, stereo, &missed);
+    size_t channels = packChannels(&synth, stereo, got);
+    synthDestroy(&synth);
+
+    if (isUpdate) {
+        printf("%-20s updated, %s\n", "builder", DEFAULT_PATCH_PATH);
+        return writeGolden("default", got, GOLDEN_FRAMES * channels) != 0;
+    }
+
+    host->freq = 0;
+    host->gate = false;
+    if (buildDefault(&synth, host) != 0) {
+        printf("%-20s FAIL: the default graph didn't build\n", "builder");
+        synthDestroy(&synth);
+        return 1;
+    }
+    synth.sampleRate = GOLDEN_SAMPLE_RATE;
+    if (synthInit(&synth) != 0) {
+        printf("%-20s FAIL: the default graph didn't init\n", "builder");
+        synthDestroy(&synth);
+        return 1;
+    }
+    render(&synth, host, NULL, 0, built, &missed);
+    synthDestroy(&synth);
+
+    struct GoldenResult result = {0};
+    const char *reason = NULL;
+    if (readGolden("default", want, GOLDEN_FRAMES * channels) != 0) {
+        reason = "no golden, run make test-update";
+    } else {
+        compare(got, want, GOLDEN_FRAMES, channels, &result);
+        if (result.maxAbs > 4 || result.rms > 1 || result.spectral > 1e-3) reason = "default.patch drifted from its golden";
+    }
+    if (reason == NULL && memcmp(built, stereo, sizeof(built)) != 0) reason = "built graph differs from default.patch";
+    // the rejects print their errors, so the verdict goes after them
+    fflush(stdout);
+    int accepted = reason == NULL ? checkRejects() : 0;
+    if (reason == NULL && accepted > 0) reason = "bad graphs accepted";
+
+    printf("%-20s %8.1f %8.3f %10.2e %s%s\n", "builder", result.maxAbs, result.rms, result.spectral,
+           reason != NULL ? "FAIL: " : "ok", reason != NULL ? reason : "");
+    return reason != NULL;
+}
+
+// a host only ever runs one variant, so the others must each stay inside
+// the same tolerances against the same goldens
+static int checkVariants(enum DspVariant skip, const bool *selected, size_t selectedLen,
+                         struct Host *host, int16_t *stereo, int16_t *got, int16_t *want) {
+    int failed = 0;
+    for (int variant = 0; variant < DSP_VARIANT_COUNT; variant++) {
+        if (variant == (int) skip) continue;
+        if (dspSelect(variant) != 0) {
+            printf("kernels: %s not supported here, skipped\n", dspVariantName(variant));
+            continue;
+        }
+
+        int variantFailed = 0;
+        for (size_t i = 0; i < TESTS_LEN; i++) {
+            if (!selected[i]) continue;
+            const struct GoldenTest *test = &tests[i];
+            struct GoldenResult result = {0};
+            size_t channels = 1;
+
+            const char *reason = NULL;
+            int err = runTest(test, host, &result, stereo, got, want, &channels, 1);
+            if (err < 0) reason = "patch didn't load";
+            else if (err > 0) reason = "no golden, run make test-update";
+            else if (result.changesMissed > 0) reason = "changed module didn't run";
+            else if (result.isChangeMistimed) reason = "change landed in the wrong block";
+            else if (result.maxAbs > test->maxAbs) reason = "max abs error";
+            else if (result.rms > test->rms) reason = "rms error";
+            else if (result.spectral > test->spectral) reason = "spectral error";
+
+            if (reason != NULL) {
+                printf("%-20s FAIL with %s kernels: %s\n", test->name, dspVariantName(variant), reason);
+                variantFailed++;
+            }
+        }
+        printf("kernels: %s, %zu tests, %d failed\n", dspVariantName(variant), selectedLen, variantFailed);
+        failed += variantFailed;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    bool isUpdate = argc > 1 && strcmp(argv[1], "--update") == 0;
+    // the baseline is rewritten whole, so an update always runs everything
+    if (isUpdate && argc > 2) {
+        fprintf(stderr, "--update runs every test\n");
+        return 1;
+    }
+    bool selected[TESTS_LEN];
+    size_t selectedLen = 0;
+    for (size_t i = 0; i < TESTS_LEN; i++) selected[i] = argc == 1 || isUpdate;
+    for (int arg = 1 + isUpdate; arg < argc; arg++) {
+        size_t i = 0;
+        while (i < TESTS_LEN && strcmp(argv[arg], tests[i].name) != 0) i++;
+        if (i == TESTS_LEN) {
+            fprintf(stderr, "no test %s\n", argv[arg]);
+            return 1;
+        }
+        selected[i] = true;
+    }
+    for (size_t i = 0; i < TESTS_LEN; i++) selectedLen += selected[i];
+    const char *skipPerf = getenv("GOLDEN_SKIP_PERF");
+    const char *toleranceEnv = getenv("GOLDEN_PERF_TOLERANCE");
+    double perfTolerance = toleranceEnv != NULL ? atof(toleranceEnv) : GOLDEN_DEFAULT_PERF_TOLERANCE;
+
+    static int16_t stereo[2 * GOLDEN_FRAMES];
+    static int16_t got[2 * GOLDEN_FRAMES];
+    static int16_t want[2 * GOLDEN_FRAMES];
+
+    struct Host host = {0};
+    if (hostInit(&host) != 0) return 1;
+
+    FILE *baseline = NULL;
+    if (isUpdate) {
+        baseline = fopen(BASELINE_PATH, "w");
+        if (baseline == NULL) {
+            perror(BASELINE_PATH);
+            return 1;
+        }
+        fprintf(baseline, "# ns per sample, rewritten by make test-update\n");
+    }
+
+    dspInit();
+    enum DspVariant variant = dspVariant();
+    printf("kernels: %s\n", dspVariantName(variant));
+
+    int failed = 0;
+    printf("%-20s %8s %8s %10s %10s %10s %8s %8s\n", "test", "maxAbs", "rms", "spectral", "ns/sample", "baseline", "hot", "bytes");
+    for (size_t i = 0; i < TESTS_LEN; i++) {
+        if (!selected[i]) continue;
+        const struct GoldenTest *test = &tests[i];
+        struct GoldenResult result = {0};
+        size_t channels = 1;
+
+        int err = runTest(test, &host, &result, stereo, got, want, &channels, GOLDEN_TIMING_RUNS);
+        if (err < 0) {
+            printf("%-20s FAIL: patch didn't load\n", test->name);
+            failed++;
+            continue;
+        }
+
+        if (isUpdate) {
+            if (writeGolden(test->name, got, GOLDEN_FRAMES * channels) != 0) failed++;
+            fprintf(baseline, "%s %.2f\n", test->name, result.nsPerSample);
+            printf("%-20s updated, %zu channel%s, %.2f ns/sample\n", test->name, channels, channels > 1 ? "s" : "", result.nsPerSample);
+            continue;
+        }
+        if (err > 0) {
+            printf("%-20s FAIL: no golden, run make test-update\n", test->name);
+            failed++;
+            continue;
+        }
+
+        double base = baselineFor(test->name);
+        const char *reason = NULL;
+        if (result.changesMissed > 0) reason = "changed module didn't run";
+        else if (result.isChangeMistimed) reason = "change landed in the wrong block";
+        else if (result.maxAbs > test->maxAbs) reason = "max abs error";
+        else if (result.rms > test->rms) reason = "rms error";
+        else if (result.spectral > test->spectral) reason = "spectral error";
+        else if (skipPerf == NULL && base > 0 && result.nsPerSample > base * perfTolerance + GOLDEN_PERF_SLACK_NS) reason = "slower than baseline";
+
+        const struct SynthFootprint *fp = &result.footprint;
+        printf("%-20s %8.1f %8.3f %10.2e %10.2f %10.2f %8zu %8zu %s%s\n", test->name, result.maxAbs, result.rms,
+               result.spectral, result.nsPerSample, base, fp->hot, fp->hot + fp->buffers + fp->cold,
+               reason != NULL ? "FAIL: " : "ok", reason != NULL ? reason : "");
+        if (reason != NULL) failed++;
+    }
+
+    if (baseline != NULL) fclose(baseline);
+
+    if (selectedLen == TESTS_LEN) failed += checkBuilder(&host, isUpdate, stereo, got, want);
+    if (!isUpdate) failed += checkVariants(variant, selected, selectedLen, &host, stereo, got, want);
+    dspSelect(variant);
+    hostFree(&host);
+
+    // make test-rt, anything the renders called that could block fails the run
+    if (rtViolations() > 0) {
+        printf("rtcheck: %zu call sites blocked the render thread, see below\n", rtViolations());
+        failed++;
+    }
+
+    printf("%zu tests, %d failed\n", selectedLen, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <unistd.h>
 #include <termios.h>
@@ -5,7 +7,11 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/ioctl.h>
 #include "tui.h"
+#include "screen.h"
 
 const struct ColorInfo defaultSliderClrs = {
     .fg = CLR_W,
@@ -14,41 +20,26 @@ const struct ColorInfo defaultSliderClrs = {
     .bgFoc = CLR_BG_BR_K
 };
 
-static void resetKeyRepeatRate(void) {
-    system("xset r rate 660");
-    system("xset r 43");
-    system("xset r 30");
-}
+static void boxDrawOutline(struct Box *box);
 
-static void setKeyRepeatRate(enum ElementType elementType) {
-    return;
-    switch (elementType) {
-    case ELEMENT_SLIDER:
-        system("xset r rate 25");
-        system("xset -r 43");
-        system("xset -r 30");
-        break;
-    case ELEMENT_RADIOS:
-        resetKeyRepeatRate();
-        break;
-    }
+static double nowMs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
 }
-static void boxDrawOutline(struct Box *box);
 
-void tuiAddScope(struct Scope *scope, int16_t *in, int x, int y, int width, int height, int horScale, double *triggerVal, enum ScopeTriggerMode trigMode) {
+void tuiAddScope(struct Tui *tui, struct Scope *scope, struct SampleRing *in, int x, int y, int width, int height, int horScale, double *triggerVal, enum ScopeTriggerMode trigMode, int intervalMs) {
     scope->in = in;
     scope->triggerVal = triggerVal;
     scope->x = x;
     scope->y = y;
-    scope->width = width;
+    scope->width = width > SCREEN_MAX_WIDTH ? SCREEN_MAX_WIDTH : width;
     scope->height = height;
-    scope->horScale = horScale;
+    scope->horScale = horScale < 1 ? 1 : horScale;
     scope->trigMode = trigMode;
-
-    scope->t = 0;
-    scope->xPos = 0;
-    scope->prevIn = INT16_MIN;
-    scope->canTrigger = false;
+    scope->intervalMs = intervalMs < SCOPE_MIN_INTERVAL_MS ? SCOPE_MIN_INTERVAL_MS : intervalMs;
+    scope->lastUpdateMs = 0;
+    scope->lastWriteIdx = 0;
 
     struct Box scopeBox = {
         .x = x,
@@ -60,6 +51,9 @@ void tuiAddScope(struct Scope *scope, int16_t *in, int x, int y, int width, int
         .style = OUTLINE_THIN,
     };
     boxDrawOutline(&scopeBox);
+
+    tui->scopes[tui->scopesLen] = scope;
+    ++tui->scopesLen;
 }
 
 static bool evalTrigger(int16_t curIn, int16_t prevIn, double triggerVal, enum ScopeTriggerMode trigMode) {
@@ -77,59 +71,198 @@ static bool evalTrigger(int16_t curIn, int16_t prevIn, double triggerVal, enum S
     return out;
 }
 
-void tuiDrawScope(struct Scope *scope) {
-    ++scope->t;
+static int scopeRow(int16_t sample, int heightInner) {
+    return (double) (INT16_MAX - sample) / (INT16_MAX - INT16_MIN) * (heightInner - 1) + 0.5;
+}
+
+bool tuiDrawScope(struct Scope *scope) {
+    double now = nowMs();
+    if (now >= scope->lastUpdateMs && now - scope->lastUpdateMs < scope->intervalMs) return false;
+
+    // nothing new was tapped since the last frame
+    size_t writeIdx = ringWriteCount(scope->in);
+    if (writeIdx == scope->lastWriteIdx) return false;
+    scope->lastWriteIdx = writeIdx;
+    scope->lastUpdateMs = now;
 
     int widthInner = scope->width - 2;
     int heightInner = scope->height - 2;
     int xInner = scope->x + 1;
     int yInner = scope->y + 1;
+    if (widthInner < 1 || heightInner < 1) return false;
+
+    // keep twice the visible columns so a trigger can be found in the older half
+    int histCols = 2 * widthInner;
+    if (histCols * scope->horScale > SCOPE_MAX_SAMPLES) {
+        histCols = SCOPE_MAX_SAMPLES / scope->horScale;
+    }
+    if (histCols < widthInner) {
+        widthInner = histCols;
+    }
 
-    if (scope->xPos >= widthInner && evalTrigger(*scope->in, scope->prevIn, *scope->triggerVal, scope->trigMode)) {
-        scope->xPos = 0;
-        scope->t = 0;
-        scope->canTrigger = false;
+    size_t sampleCount = (size_t) histCols * scope->horScale;
+    if (ringReadLatest(scope->in, scope->samples, sampleCount) < sampleCount) return false;
+
+    // reduce every column to its min/max so no sample is lost at any zoom
+    for (int col = 0; col < histCols; col++) {
+        const int16_t *colSamples = scope->samples + col * scope->horScale;
+        int16_t colMin = colSamples[0];
+        int16_t colMax = colSamples[0];
+        for (int i = 1; i < scope->horScale; i++) {
+            if (colSamples[i] < colMin) colMin = colSamples[i];
+            if (colSamples[i] > colMax) colMax = colSamples[i];
+        }
+        scope->colMin[col] = colMin;
+        scope->colMax[col] = colMax;
     }
 
-    if (scope->xPos >= widthInner) {
-        scope->prevIn = *scope->in;
-        return;
+    // latest trigger that still leaves a full screen after it, else free run
+    int startCol = histCols - widthInner;
+    for (int col = histCols - widthInner; col > 0; col--) {
+        int16_t cur = (scope->colMin[col] + scope->colMax[col]) / 2;
+        int16_t prev = (scope->colMin[col - 1] + scope->colMax[col - 1]) / 2;
+        if (evalTrigger(cur, prev, *scope->triggerVal, scope->trigMode)) {
+            startCol = col;
+            break;
+        }
     }
-    if (scope->t % scope->horScale != 0) return;
 
-    printf("%s", TEXT_RESET);
-    int curY = heightInner - (double) (*scope->in + INT16_MAX) / (INT16_MAX - INT16_MIN) * heightInner;
-    int prevY = heightInner - (double) (scope->prevIn + INT16_MAX) / (INT16_MAX - INT16_MIN) * heightInner;
+    for (int x = 0; x < widthInner; x++) {
+        int col = startCol + x;
+        int16_t hi = scope->colMax[col];
+        int16_t lo = scope->colMin[col];
 
-    SET_CURSOR_POS(xInner + scope->xPos, yInner);
-    for (int i = 0; i < heightInner; i++) {
-        if (((i > curY && i <= prevY) || (i < curY && i >= prevY)) && scope->xPos > 0) {
-            printf("*");
-        } else {
-            printf(" ");
+        // stretch towards the previous column so steep edges stay connected
+        if (x > 0) {
+            if (scope->colMin[col - 1] > hi) hi = scope->colMin[col - 1];
+            if (scope->colMax[col - 1] < lo) lo = scope->colMax[col - 1];
+        }
+
+        int rowHi = scopeRow(hi, heightInner);
+        int rowLo = scopeRow(lo, heightInner);
+        for (int row = 0; row < heightInner; row++) {
+            bool isTrace = row >= rowHi && row <= rowLo;
+            screenPut(xInner + x, yInner + row, isTrace ? "*" : " ", CLR_DEFAULT, CLR_DEFAULT, 0);
         }
-        printf("%s", CURSOR_DOWN);
-        MOVE_CURSOR_LEFT(1);
     }
-    SET_CURSOR_POS(xInner + scope->xPos, yInner + curY);
-    printf("*");
+    return true;
+}
 
-    scope->prevIn = *scope->in;
-    ++scope->xPos;
-    fflush(stdout);
+void tuiAddSpectrum(struct Tui *tui, struct Spectrum *spectrum, struct SampleRing *in, int x, int y, int width, int height, size_t fftLen, enum FirWindowType window, float sampleRate, int intervalMs) {
+    if (fftLen < SPECTRUM_MIN_FFT_LEN) fftLen = SPECTRUM_MIN_FFT_LEN;
+    if (fftLen > SPECTRUM_MAX_FFT_LEN) fftLen = SPECTRUM_MAX_FFT_LEN;
+    while (fftLen & (fftLen - 1)) {
+        fftLen &= fftLen - 1;
+    }
+
+    spectrum->in = in;
+    spectrum->fftLen = fftLen;
+    spectrum->sampleRate = sampleRate;
+    spectrum->x = x;
+    spectrum->y = y;
+    spectrum->width = width > SCREEN_MAX_WIDTH ? SCREEN_MAX_WIDTH : width;
+    spectrum->height = height;
+    spectrum->intervalMs = intervalMs < SPECTRUM_MIN_INTERVAL_MS ? SPECTRUM_MIN_INTERVAL_MS : intervalMs;
+    spectrum->lastUpdateMs = 0;
+    spectrum->lastWriteIdx = 0;
+    spectrum->plan = fftPlanCreate(fftLen);
+
+    createFirWindow(spectrum->window, window, fftLen);
+    spectrum->windowSum = 0;
+    for (size_t i = 0; i < fftLen; i++) {
+        spectrum->windowSum += spectrum->window[i];
+    }
+
+    struct Box spectrumBox = {
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+        .isFoc = false,
+        .label = "",
+        .style = OUTLINE_THIN,
+    };
+    boxDrawOutline(&spectrumBox);
+
+    tui->spectrums[tui->spectrumsLen] = spectrum;
+    ++tui->spectrumsLen;
 }
 
-static void radiosDraw(struct Radios *radios) {
-    SET_CURSOR_POS(radios->x, radios->y);
-    printf("%s", TEXT_RESET);
+void tuiFreeSpectrum(struct Spectrum *spectrum) {
+    fftPlanDestroy(spectrum->plan);
+    spectrum->plan = NULL;
+}
+
+bool tuiDrawSpectrum(struct Spectrum *spectrum) {
+    if (spectrum->plan == NULL) return false;
+
+    double now = nowMs();
+    if (now >= spectrum->lastUpdateMs && now - spectrum->lastUpdateMs < spectrum->intervalMs) return false;
+
+    size_t writeIdx = ringWriteCount(spectrum->in);
+    if (writeIdx == spectrum->lastWriteIdx) return false;
+    spectrum->lastWriteIdx = writeIdx;
+    spectrum->lastUpdateMs = now;
+
+    size_t fftLen = spectrum->fftLen;
+    if (ringReadLatest(spectrum->in, spectrum->samples, fftLen) < fftLen) return false;
+
+    for (size_t i = 0; i < fftLen; i++) {
+        spectrum->fftBuf[i] = spectrum->samples[i] * spectrum->window[i];
+    }
+    fftRealForward(spectrum->plan, spectrum->fftBuf);
+
+    int widthInner = spectrum->width - 2;
+    int heightInner = spectrum->height - 2;
+    int xInner = spectrum->x + 1;
+    int yInner = spectrum->y + 1;
+    if (widthInner < 1 || heightInner < 1) return false;
+
+    int maxLevel = heightInner * (barsVertLen - 1);
+    float binHz = spectrum->sampleRate / fftLen;
+    float logSpan = logf(spectrum->sampleRate / 2 / SPECTRUM_MIN_FREQ);
+    // a full scale sine peaks at INT16_MAX * windowSum / 2
+    float fullScale = INT16_MAX * spectrum->windowSum / 2;
+    int levels[SCREEN_MAX_WIDTH];
+
+    for (int col = 0; col < widthInner; col++) {
+        size_t loBin = SPECTRUM_MIN_FREQ * expf(logSpan * col / widthInner) / binHz;
+        size_t hiBin = SPECTRUM_MIN_FREQ * expf(logSpan * (col + 1) / widthInner) / binHz;
+        if (hiBin <= loBin) hiBin = loBin + 1;
+        if (hiBin > fftLen / 2 + 1) hiBin = fftLen / 2 + 1;
+
+        float peak = 0;
+        for (size_t k = loBin; k < hiBin; k++) {
+            Cplx bin = fftRealBin(spectrum->plan, spectrum->fftBuf, k);
+            float mag = sqrtf(bin.real * bin.real + bin.imag * bin.imag);
+            if (mag > peak) peak = mag;
+        }
+
+        float db = 20 * log10f(peak / fullScale + 1e-9f);
+        int level = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB * maxLevel;
+        if (level < 0) level = 0;
+        if (level > maxLevel) level = maxLevel;
+        levels[col] = level;
+    }
 
+    for (int row = 0; row < heightInner; row++) {
+        int rowBase = (heightInner - 1 - row) * (barsVertLen - 1);
+        for (int col = 0; col < widthInner; col++) {
+            int cell = levels[col] - rowBase;
+            if (cell < 0) cell = 0;
+            if (cell > barsVertLen - 1) cell = barsVertLen - 1;
+            screenPut(xInner + col, yInner + row, barsVert[cell], CLR_DEFAULT, CLR_DEFAULT, 0);
+        }
+    }
+    return true;
+}
+
+static void radiosDraw(struct Radios *radios) {
     for (int i = 0; i < radios->buttonCount; i++) {
-        SET_CURSOR_POS(radios->x, radios->y + i);
-        printf("%s", radios->buttonList[i].isSelected ? "* " : "  ");
-        printf("%s", radios->buttonList[i].name);
+        screenPutStr(radios->x, radios->y + i, radios->buttonList[i].isSelected ? "* " : "  ", -1, CLR_DEFAULT, CLR_DEFAULT, 0);
+        screenPutStr(radios->x + 2, radios->y + i, radios->buttonList[i].name, -1, CLR_DEFAULT, CLR_DEFAULT, 0);
     }
-    SET_CURSOR_POS(radios->x, radios->y + radios->buttonCount);
-    printf("%s%s", radios->isFoc ? clrsBG[CLR_BG_BR_K] : clrsBG[CLR_BG_K], radios->label);
+    screenPutStr(radios->x, radios->y + radios->buttonCount, radios->label, -1, CLR_DEFAULT, radios->isFoc ? CLR_BG_BR_K : CLR_BG_K, 0);
 }
 
 
@@ -143,7 +276,6 @@ void boxAddRadios(struct Box *box, struct Radios *radios, int x, int y, char *la
 
     if (box->elementsLen == 0  && box->isFoc) {
         radios->isFoc = true;
-        setKeyRepeatRate(ELEMENT_RADIOS);
     } else {
         radios->isFoc = false;
     }
@@ -168,7 +300,6 @@ void sliderSetClr(struct Slider *slider, enum ColorFG fg, enum ColorBG bg, enum
 }
 
 static void sliderDraw(struct Slider *slider) {
-    SET_CURSOR_POS(1, 1);
     enum ColorFG curFgClr = slider->isFoc ? slider->clrs.fgFoc : slider->clrs.fg;
     enum ColorBG curBgClr = slider->isFoc ? slider->clrs.bgFoc : slider->clrs.bg;
 
@@ -178,22 +309,20 @@ static void sliderDraw(struct Slider *slider) {
     int divLen = slider->height * (barsVertLen - 1);
     int boundary = (slider->height * slider->divVal) / divLen;
 
-    SET_CURSOR_POS(slider->x, slider->y);
-    printf("%s", clrsFG[curFgClr]);
     for (int i = slider->height - 1; i >= 0; i--) {
-        printf("%s", clrsBG[curBgClr]);
-        printf("%s", clrsFG[curFgClr]);
+        const char *bar;
         if (i == boundary) {
-            printf("%s", barsVert[slider->divVal % (barsVertLen - 1)]);
+            bar = barsVert[slider->divVal % (barsVertLen - 1)];
         } else if (i < boundary) {
-            printf("%s", barsVert[barsVertLen - 1]);
-        } else if (i > boundary) {
-            printf("%s", barsVert[0]);
+            bar = barsVert[barsVertLen - 1];
+        } else {
+            bar = barsVert[0];
         }
-        printf("\b%s", CURSOR_DOWN);
+        screenPut(slider->x, slider->y + slider->height - 1 - i, bar, curFgClr, curBgClr, 0);
     }
-    printf("%s%s%s%c", TEXT_BOLD, clrsBG[curLabelBgClr], clrsFG[curLabelFgClr], slider->label);
-    SET_CURSOR_POS(slider->x, slider->y);
+
+    char label[] = { slider->label, '\0' };
+    screenPut(slider->x, slider->y + slider->height, label, curLabelFgClr, curLabelBgClr, CELL_BOLD);
 }
 
 static void sliderIncr(struct Slider *slider, int incr) {
@@ -246,22 +375,46 @@ void radiosAddButton(struct Radios *radios, char *name, int val) {
     }
 
     ++radios->buttonCount;
-   radiosDraw(radios); 
+    radios->isDirty = true;
 }
 
-static void elementDraw(struct Element element) {
+static void elementInvalidate(struct Element element) {
     switch (element.type) {
     case ELEMENT_SLIDER:
         element.ptr.slider->isFoc = element.isFoc;
-        sliderDraw(element.ptr.slider);
+        element.ptr.slider->isDirty = true;
         break;
     case ELEMENT_RADIOS:
         element.ptr.radios->isFoc = element.isFoc;
-        radiosDraw(element.ptr.radios);
+        element.ptr.radios->isDirty = true;
         break;
     }
+}
 
-    fflush(stdout);
+static bool elementIsDirty(struct Element element) {
+    switch (element.type) {
+    case ELEMENT_SLIDER:
+        return element.ptr.slider->isDirty;
+    case ELEMENT_RADIOS:
+        return element.ptr.radios->isDirty;
+    }
+    return false;
+}
+
+static bool elementDrawIfDirty(struct Element element) {
+    switch (element.type) {
+    case ELEMENT_SLIDER:
+        if (!element.ptr.slider->isDirty) return false;
+        sliderDraw(element.ptr.slider);
+        element.ptr.slider->isDirty = false;
+        break;
+    case ELEMENT_RADIOS:
+        if (!element.ptr.radios->isDirty) return false;
+        radiosDraw(element.ptr.radios);
+        element.ptr.radios->isDirty = false;
+        break;
+    }
+    return true;
 }
 
 void boxAddSlider(struct Box *box, struct Slider *slider, int x, int y, int height, double minVal, double maxVal, char label) {
@@ -284,7 +437,6 @@ void boxAddSlider(struct Box *box, struct Slider *slider, int x, int y, int heig
     if (box->elementsLen == 0) {
         box->elements[0].isFoc = true;
         slider->isFoc = true;
-        setKeyRepeatRate(ELEMENT_SLIDER);
     } else {
         box->elements[box->elementsLen].isFoc = false;
         slider->isFoc = false;
@@ -292,7 +444,7 @@ void boxAddSlider(struct Box *box, struct Slider *slider, int x, int y, int heig
 
     box->elements[box->elementsLen].ptr.slider = slider;
     box->elements[box->elementsLen].type = ELEMENT_SLIDER;
-    elementDraw(box->elements[box->elementsLen]);
+    elementInvalidate(box->elements[box->elementsLen]);
 
     ++box->elementsLen;
 }
@@ -309,7 +461,7 @@ void boxIncrFocElement(struct Box *box) {
         radiosSelectButtonUp(curElement.ptr.radios);
         break;
     }
-    elementDraw(curElement);
+    elementInvalidate(curElement);
 }
 
 void boxDecrFocElement(struct Box *box) {
@@ -323,14 +475,14 @@ void boxDecrFocElement(struct Box *box) {
         radiosSelectButtonDown(curElement.ptr.radios);
         break;
     }
-    elementDraw(curElement);
+    elementInvalidate(curElement);
 }
 
 void boxNextElement(struct Box *box) {
     if (box->elementsLen == 0) return;
 
     box->elements[box->focElementIdx].isFoc = false;
-    elementDraw(box->elements[box->focElementIdx]);
+    elementInvalidate(box->elements[box->focElementIdx]);
 
     if (box->focElementIdx == box->elementsLen - 1) {
         box->focElementIdx = 0;
@@ -340,15 +492,14 @@ void boxNextElement(struct Box *box) {
 
     box->elements[box->focElementIdx].isFoc = true;
 
-    setKeyRepeatRate(box->elements[box->focElementIdx].type);
-    elementDraw(box->elements[box->focElementIdx]);
+    elementInvalidate(box->elements[box->focElementIdx]);
 }
 
 void boxPrevElement(struct Box *box) {
     if (box->elementsLen == 0) return;
 
     box->elements[box->focElementIdx].isFoc = false;
-    elementDraw(box->elements[box->focElementIdx]);
+    elementInvalidate(box->elements[box->focElementIdx]);
 
     if (box->focElementIdx == 0) {
         box->focElementIdx = box->elementsLen - 1;
@@ -358,8 +509,7 @@ void boxPrevElement(struct Box *box) {
 
     box->elements[box->focElementIdx].isFoc = true;
 
-    setKeyRepeatRate(box->elements[box->focElementIdx].type);
-    elementDraw(box->elements[box->focElementIdx]);
+    elementInvalidate(box->elements[box->focElementIdx]);
 }
 
 static void boxDrawOutline(struct Box *box) {
@@ -370,50 +520,85 @@ static void boxDrawOutline(struct Box *box) {
         labelLen = box->width - 2;
     }
 
-    SET_CURSOR_POS(box->x, box->y);
-    printf("%s", TEXT_RESET);
-    printf("%s", box->isFoc ? clrsFG[CLR_BR_W] : clrsFG[CLR_BR_K]);
+    const char **chars = outlineChars[box->style];
+    int fg = box->isFoc ? CLR_BR_W : CLR_BR_K;
+    int right = box->x + box->width - 1;
+    int bottom = box->y + box->height - 1;
 
-    printf("%s", outlineChars[box->style][OUTLINE_UPPER_LEFT_CORNER]);
-    printf("%.*s", labelLen, box->label);
-    for (int i = 0; i < box->width - labelLen - 2; i++) {
-        printf("%s", outlineChars[box->style][OUTLINE_HOR_LINE]);
+    screenPut(box->x, box->y, chars[OUTLINE_UPPER_LEFT_CORNER], fg, CLR_DEFAULT, 0);
+    int labelCells = screenPutStr(box->x + 1, box->y, box->label, labelLen, fg, CLR_DEFAULT, 0);
+    for (int x = box->x + 1 + labelCells; x < right; x++) {
+        screenPut(x, box->y, chars[OUTLINE_HOR_LINE], fg, CLR_DEFAULT, 0);
     }
-    printf("%s\b", outlineChars[box->style][OUTLINE_UPPER_RIGHT_CORNER]);
-
-    SET_CURSOR_POS(box->x, box->y + 1);
+    screenPut(right, box->y, chars[OUTLINE_UPPER_RIGHT_CORNER], fg, CLR_DEFAULT, 0);
 
-    for (int i = 0; i < box->height - 2; i++) {
-        printf("%s", outlineChars[box->style][OUTLINE_VERT_LINE]);
-        MOVE_CURSOR_RIGHT(box->width - 2);
-        printf("%s", outlineChars[box->style][OUTLINE_VERT_LINE]);
-        MOVE_CURSOR_LEFT(box->width);
-        printf("%s", CURSOR_DOWN);
-    }
-    printf("%s", outlineChars[box->style][OUTLINE_LOWER_LEFT_CORNER]);
-    for (int i = 0; i < box->width - 2; i++) {
-        printf("%s", outlineChars[box->style][OUTLINE_HOR_LINE]);
+    for (int y = box->y + 1; y < bottom; y++) {
+        screenPut(box->x, y, chars[OUTLINE_VERT_LINE], fg, CLR_DEFAULT, 0);
+        screenPut(right, y, chars[OUTLINE_VERT_LINE], fg, CLR_DEFAULT, 0);
     }
-    printf("%s\b", outlineChars[box->style][OUTLINE_LOWER_RIGHT_CORNER]);
 
-    SET_CURSOR_POS(box->x, box->y);
-
-    fflush(stdout);
+    screenPut(box->x, bottom, chars[OUTLINE_LOWER_LEFT_CORNER], fg, CLR_DEFAULT, 0);
+    for (int x = box->x + 1; x < right; x++) {
+        screenPut(x, bottom, chars[OUTLINE_HOR_LINE], fg, CLR_DEFAULT, 0);
+    }
+    screenPut(right, bottom, chars[OUTLINE_LOWER_RIGHT_CORNER], fg, CLR_DEFAULT, 0);
 }
 
 void tuiInit(struct Tui *tui, char *label) {
     tui->label = label;
     tui->boxesLen = 0;
+    tui->scopesLen = 0;
+    tui->spectrumsLen = 0;
     tui->focBoxIdx = 0;
 }
 
+// redraws invalidated elements and presents, skipping the frame when nothing changed
+bool tuiFrame(struct Tui *tui) {
+    bool drew = false;
+
+    for (int i = 0; i < tui->boxesLen; i++) {
+        struct Box *box = tui->boxes[i];
+        if (box->isDirty) {
+            boxDrawOutline(box);
+            box->isDirty = false;
+            drew = true;
+        }
+        for (int j = 0; j < box->elementsLen; j++) {
+            drew |= elementDrawIfDirty(box->elements[j]);
+        }
+    }
+    for (int i = 0; i < tui->scopesLen; i++) {
+        drew |= tuiDrawScope(tui->scopes[i]);
+    }
+    for (int i = 0; i < tui->spectrumsLen; i++) {
+        drew |= tuiDrawSpectrum(tui->spectrums[i]);
+    }
+
+    if (drew) {
+        screenPresent();
+    }
+    return drew;
+}
+
+bool tuiIsIdle(const struct Tui *tui) {
+    if (tui->scopesLen > 0 || tui->spectrumsLen > 0) return false;
+    for (int i = 0; i < tui->boxesLen; i++) {
+        const struct Box *box = tui->boxes[i];
+        if (box->isDirty) return false;
+        for (int j = 0; j < box->elementsLen; j++) {
+            if (elementIsDirty(box->elements[j])) return false;
+        }
+    }
+    return true;
+}
+
 void boxToggleFocus(struct Box *box) {
     if (box->elementsLen > 0) {
         box->elements[box->focElementIdx].isFoc = box->isFoc ? false : true;
-        elementDraw(box->elements[box->focElementIdx]);
+        elementInvalidate(box->elements[box->focElementIdx]);
     }
     box->isFoc = box->isFoc ? false : true;
-    boxDrawOutline(box);
+    box->isDirty = true;
 }
 
 void tuiNextBox(struct Tui *tui) {
@@ -427,7 +612,6 @@ void tuiNextBox(struct Tui *tui) {
 
     struct Box *focBox = tui->boxes[tui->focBoxIdx];
     boxToggleFocus(focBox);
-    setKeyRepeatRate(focBox->elements[focBox->focElementIdx].type);
 }
 
 void tuiPrevBox(struct Tui *tui) {
@@ -441,7 +625,6 @@ void tuiPrevBox(struct Tui *tui) {
 
     struct Box *focBox = tui->boxes[tui->focBoxIdx];
     boxToggleFocus(focBox);
-    setKeyRepeatRate(focBox->elements[focBox->focElementIdx].type);
 }
 
 void tuiAddBox(struct Tui *tui, struct Box *box, int x, int y, int width, int height, char *label, enum OutlineStyle style) {
@@ -460,8 +643,7 @@ void tuiAddBox(struct Tui *tui, struct Box *box, int x, int y, int width, int he
     box->focElementIdx = 0;
 
     box->isFoc = tui->boxesLen == 0 ? true : false;
-
-    boxDrawOutline(box);
+    box->isDirty = true;
 
     tui->boxes[tui->boxesLen] = box;
     ++tui->boxesLen;
@@ -472,16 +654,23 @@ void termInit(void) {
     tcgetattr(STDIN_FILENO, &oldTerm);
     newTerm = oldTerm;
     newTerm.c_lflag &= ~(ICANON | ECHO);
+    newTerm.c_cc[VMIN] = 1;
+    newTerm.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSANOW, &newTerm);
-    printf("%s", CURSOR_HIDE);
+    printf("%s%s", CURSOR_HIDE, CLEAR_SCREEN);
 
-    system("clear");
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) {
+        screenInit(size.ws_col, size.ws_row);
+    } else {
+        screenInit(80, 24);
+    }
 }
 
 
 void resetTerm(void) {
     tcsetattr(STDIN_FILENO, TCSANOW, &oldTerm);
     printf("%s%s", CURSOR_SHOW, TEXT_RESET);
-    resetKeyRepeatRate();
+    fflush(stdout);
 }
 
@@ -2,6 +2,9 @@
 #define TUI_H
 
 #include "engine.h"
+#include "fft.h"
+#include "ring.h"
+#include "screen.h"
 
 #define LIST_BUF_SIZE 64
 
@@ -12,6 +15,7 @@
 #define CURSOR_SHOW "\033[?25h"
 #define CURSOR_UP "\033[A"
 #define CURSOR_DOWN "\033[B"
+#define CLEAR_SCREEN "\033[2J\033[H"
 
 #define SET_CURSOR_POS(x, y) printf("\033[%d;%dH", y, x)
 #define MOVE_CURSOR_RIGHT(x) printf("\033[%dC", x)
@@ -19,6 +23,17 @@
 
 #define MAX_RADIO_BUTTONS 8
 
+#define TUI_DEFAULT_FPS 30
+
+#define SCOPE_MAX_SAMPLES (RING_BUF_SIZE / 2)
+#define SCOPE_MIN_INTERVAL_MS 16
+
+#define SPECTRUM_MIN_FFT_LEN 64
+#define SPECTRUM_MAX_FFT_LEN 4096
+#define SPECTRUM_MIN_INTERVAL_MS 50
+#define SPECTRUM_MIN_FREQ 20.0f
+#define SPECTRUM_FLOOR_DB -90.0f
+
 enum ScopeTriggerMode {
     TRIG_RISING_EDGE,
     TRIG_FALLING_EDGE,
@@ -120,6 +135,7 @@ struct Slider {
     int divVal;
     char label;
     bool isFoc;
+    bool isDirty;
     struct ColorInfo clrs;
 };
 
@@ -138,21 +154,42 @@ struct Radios {
     int y;
     int val;
     bool isFoc;
+    bool isDirty;
 };
 
 struct Scope {
-    int16_t *in;
+    struct SampleRing *in;
     double *triggerVal;
     int x;
     int y;
     int width;
     int height;
     int horScale;
-    int xPos;
+    int intervalMs;
+    double lastUpdateMs;
+    size_t lastWriteIdx;
     enum ScopeTriggerMode trigMode;
-    int16_t prevIn;
-    int16_t t;
-    bool canTrigger;
+    int16_t samples[SCOPE_MAX_SAMPLES];
+    int16_t colMin[2 * SCREEN_MAX_WIDTH];
+    int16_t colMax[2 * SCREEN_MAX_WIDTH];
+};
+
+struct Spectrum {
+    struct SampleRing *in;
+    struct FftPlan *plan;
+    float window[SPECTRUM_MAX_FFT_LEN];
+    float fftBuf[SPECTRUM_MAX_FFT_LEN];
+    int16_t samples[SPECTRUM_MAX_FFT_LEN];
+    size_t fftLen;
+    float windowSum;
+    float sampleRate;
+    int x;
+    int y;
+    int width;
+    int height;
+    int intervalMs;
+    double lastUpdateMs;
+    size_t lastWriteIdx;
 };
 
 struct Element {
@@ -177,13 +214,18 @@ struct Box {
     int width;
     int height;
     bool isFoc;
+    bool isDirty;
 };
 
 struct Tui {
     struct Box *boxes[LIST_BUF_SIZE];
+    struct Scope *scopes[LIST_BUF_SIZE];
+    struct Spectrum *spectrums[LIST_BUF_SIZE];
     char *label;
     int focBoxIdx;
     int boxesLen;
+    int scopesLen;
+    int spectrumsLen;
 };
 
 extern const char *barsVert[];
@@ -194,10 +236,20 @@ extern const char *clrsFG[];
 extern const char *clrsBG[];
 extern const char *outlineChars[OUTLINE_STYLE_COUNT][OUTLINE_CHAR_COUNT];
 
-void tuiAddScope(struct Scope *scope, int16_t *in, int x, int y, int width, int height, int horScale, double *triggerVal, enum ScopeTriggerMode trigMode);
-void tuiDrawScope(struct Scope *scope);
+void tuiAddScope(struct Tui *tui, struct Scope *scope, struct SampleRing *in, int x, int y, int width, int height, int horScale, double *triggerVal, enum ScopeTriggerMode trigMode, int intervalMs);
+bool tuiDrawScope(struct Scope *scope);
+
+void tuiAddSpectrum(struct Tui *tui, struct Spectrum *spectrum, struct SampleRing *in, int x, int y, int width, int height, size_t fftLen, enum FirWindowType window, float sampleRate, int intervalMs);
+bool tuiDrawSpectrum(struct Spectrum *spectrum);
+void tuiFreeSpectrum(struct Spectrum *spectrum);
 
 void tuiInit(struct Tui *tui, char *label);
+// redraws invalidated elements and presents, skipping the frame when nothing
+// changed. the event loop calls it on every tick, so its tick rate is the
+// frame rate
+bool tuiFrame(struct Tui *tui);
+// nothing is animated or waiting to be drawn, so frames can stop until input
+bool tuiIsIdle(const struct Tui *tui);
 void tuiNextBox(struct Tui *tui);
 void tuiPrevBox(struct Tui *tui);
 void tuiAddBox(struct Tui *tui, struct Box *box, int x, int y, int width, int height, char *label, enum OutlineStyle style);
@@ -0,0 +1,116 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "fft.h"
+#include "sampler.h"
+#include "wavetable.h"
+
+static pthread_mutex_t banksLock = PTHREAD_MUTEX_INITIALIZER;
+static struct WavetableBank *banks;
+
+const float *wavetableFrame(const struct WavetableBank *bank, size_t level, size_t frame) {
+    return bank->tables + (level * bank->framesLen + frame) * WAVETABLE_FRAME_LEN;
+}
+
+// one forward FFT per frame, then an inverse per level with the harmonics
+// above that level's limit cut
+static void buildMipmaps(float *tables, const struct SampleData *sample, size_t framesLen,
+                         const struct FftPlan *plan) {
+    float spectrum[WAVETABLE_FRAME_LEN];
+
+    for (size_t frame = 0; frame < framesLen; frame++) {
+        for (size_t i = 0; i < WAVETABLE_FRAME_LEN; i++) {
+            spectrum[i] = sampleFrame(sample, frame * WAVETABLE_FRAME_LEN + i) / 32768.0f;
+        }
+        fftRealForward(plan, spectrum);
+        spectrum[1] = 0;
+
+        for (size_t level = 0; level < WAVETABLE_LEVELS; level++) {
+            float *table = tables + (level * framesLen + frame) * WAVETABLE_FRAME_LEN;
+            size_t maxHarmonic = (WAVETABLE_FRAME_LEN / 2) >> level;
+
+            memcpy(table, spectrum, sizeof(spectrum));
+            for (size_t k = maxHarmonic; k < WAVETABLE_FRAME_LEN / 2; k++) {
+                table[2 * k] = 0;
+                table[2 * k + 1] = 0;
+            }
+            fftRealInverse(plan, table);
+        }
+    }
+}
+
+static struct WavetableBank *wavetableLoad(const char *path) {
+    struct SampleData sample;
+    if (sampleOpen(&sample, path) != 0) return NULL;
+
+    size_t framesLen = sample.framesLen / WAVETABLE_FRAME_LEN;
+    if (framesLen == 0 || sample.framesLen % WAVETABLE_FRAME_LEN != 0) {
+        fprintf(stderr, "%s: length isn't a multiple of %d frames\n", path, WAVETABLE_FRAME_LEN);
+        sampleClose(&sample);
+        return NULL;
+    }
+
+    // header and tables share one mapping that turns read-only once built
+    size_t headerLen = arenaAlignUp(sizeof(struct WavetableBank), sysconf(_SC_PAGESIZE));
+    size_t mapLen = headerLen + WAVETABLE_LEVELS * framesLen * WAVETABLE_FRAME_LEN * sizeof(float);
+    char *map = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    struct FftPlan *plan = fftPlanCreate(WAVETABLE_FRAME_LEN);
+    if (map == MAP_FAILED || plan == NULL) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        if (map != MAP_FAILED) munmap(map, mapLen);
+        fftPlanDestroy(plan);
+        sampleClose(&sample);
+        return NULL;
+    }
+
+    float *tables = (float*) (map + headerLen);
+    buildMipmaps(tables, &sample, framesLen, plan);
+    fftPlanDestroy(plan);
+    sampleClose(&sample);
+
+    struct WavetableBank *bank = (struct WavetableBank*) map;
+    bank->framesLen = framesLen;
+    bank->tables = tables;
+    snprintf(bank->_priv.path, sizeof(bank->_priv.path), "%s", path);
+    bank->_priv.mapLen = mapLen;
+    mprotect(map + headerLen, mapLen - headerLen, PROT_READ);
+    return bank;
+}
+
+struct WavetableBank *wavetableAcquire(const char *path) {
+    pthread_mutex_lock(&banksLock);
+
+    struct WavetableBank *bank = banks;
+    while (bank != NULL && strcmp(bank->_priv.path, path) != 0) bank = bank->_priv.next;
+
+    if (bank == NULL && (bank = wavetableLoad(path)) != NULL) {
+        bank->_priv.next = banks;
+        banks = bank;
+    }
+    if (bank != NULL) bank->_priv.refs++;
+
+    pthread_mutex_unlock(&banksLock);
+    return bank;
+}
+
+void wavetableRelease(struct WavetableBank *bank) {
+    if (bank == NULL) return;
+    pthread_mutex_lock(&banksLock);
+
+    if (--bank->_priv.refs == 0) {
+        struct WavetableBank **link = &banks;
+        while (*link != bank) link = &(*link)->_priv.next;
+        *link = bank->_priv.next;
+        munmap(bank, bank->_priv.mapLen);
+    }
+
+    pthread_mutex_unlock(&banksLock);
+}
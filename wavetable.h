@@ -0,0 +1,34 @@
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include <stddef.h>
+
+#define WAVETABLE_FRAME_LEN 2048
+// level 0 keeps every harmonic of a frame, each level above keeps half as many
+#define WAVETABLE_LEVELS 11
+#define WAVETABLE_PATH_SIZE 256
+#define WAVETABLE_MAX_BANKS 16
+
+// single-cycle frames band-limited per octave at load time. a bank lives in
+// one read-only mapping and is shared by every oscillator that plays it
+struct WavetableBank {
+    size_t framesLen;
+    // tables[(level * framesLen + frame) * WAVETABLE_FRAME_LEN + i]
+    const float *tables;
+
+    struct {
+        char path[WAVETABLE_PATH_SIZE];
+        int refs;
+        size_t mapLen;
+        struct WavetableBank *next;
+    } _priv;
+};
+
+// loads a WAV of back to back WAVETABLE_FRAME_LEN sample frames, or hands out
+// the bank already loaded from the same path
+struct WavetableBank *wavetableAcquire(const char *path);
+void wavetableRelease(struct WavetableBank *bank);
+
+const float *wavetableFrame(const struct WavetableBank *bank, size_t level, size_t frame);
+
+#endif //WAVETABLE_H